@@ -1,26 +1,118 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <stdint.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define INITIAL_HASHSIZE 128
-#define MAX_MACRO_LENGTH 1024
-#define MIN_HASHSIZE 64
-#define MAX_HASHSIZE 1024
+#define MAX_LOAD_PERCENT 80
+#define INITIAL_ARENA_SIZE 4096
+#define MAX_THREADS 64
+#define PROBE_HISTOGRAM_SIZE 8
+#define MACRO_CACHE_MAGIC "MCT2"
+#define MACRO_CACHE_MAGIC_INIT {'M', 'C', 'T', '2'}
+
+#define HASH_PRIME1 UINT64_C(0x9E3779B185EBCA87)
+#define HASH_PRIME2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define HASH_PRIME3 UINT64_C(0x165667B19E3779F9)
+#define HASH_PRIME4 UINT64_C(0x85EBCA77C2B2AE63)
+#define HASH_PRIME5 UINT64_C(0x27D4EB2F165667C5)
+#define MIN_PARALLEL_SIZE (1 << 20)
+#define EXPAND_CHUNK_SIZE ((size_t) 4 << 20)
+#define MAX_EXPANSION_BYTES ((size_t) 64 << 20)
+
+// Все имена и значения лежат подряд в одной арене, слоты хранят смещения,
+// поэтому рост арены не ломает таблицу
+typedef struct {
+    char *data;
+    size_t size;
+    size_t capacity;
+} StringArena;
+
+typedef enum {
+    EXPANSION_NONE = 0,
+    EXPANSION_DONE
+} ExpansionState;
+
+// distance — длина пробы от "домашнего" слота плюс один, 0 означает пустой слот.
+// expansion_* — закешированная полностью раскрытая подстановка (тоже в арене)
+typedef struct {
+    uint64_t hash;
+    size_t distance;
+    size_t name_offset;
+    size_t name_length;
+    size_t value_offset;
+    size_t value_length;
+    size_t expansion_offset;
+    size_t expansion_length;
+    ExpansionState state;
+} MacroSlot;
 
-typedef struct MacroNode {
-    char *name;
-    char *value;
-    struct MacroNode *next;
-} MacroNode;
+// Раскрытие, посчитанное во второй фазе, до переноса в арену
+typedef struct {
+    size_t length;
+    char data[];
+} MacroExpansion;
 
+// Открытая адресация по схеме Robin Hood, размер таблицы — степень двойки.
+// expansions — параллельный slots массив раскрытий, найденных второй фазой;
+// публикуются через CAS, поэтому потоки пополняют его без блокировок
 typedef struct {
-    MacroNode **table;
+    MacroSlot *slots;
     size_t size;
     size_t count;
+    size_t rehash_count;
+    StringArena arena;
+    void *mapping;
+    size_t mapping_size;
+    _Atomic(MacroExpansion *) *expansions;
+    atomic_size_t expansion_bytes;
 } HashTable;
 
+// Кадр раскрытия: текст (значение макроса или строка тела), позиция в нём
+// и начало его вывода в out. Для строки тела slot == NULL
+typedef struct {
+    const MacroSlot *slot;
+    const char *text;
+    size_t length;
+    size_t position;
+    size_t output_start;
+    int cyclic;
+} ExpansionFrame;
+
+// stack — кадры макросов, раскрываемых сейчас. Стек в куче, а не рекурсия:
+// глубина цепочки ограничена только памятью. active — битовая карта слотов из stack,
+// у каждого потока своя, чтобы проверка на цикл не просматривала стек
+typedef struct {
+    HashTable *ht;
+    ExpansionFrame *stack;
+    size_t depth;
+    size_t capacity;
+    unsigned char *active;
+} ExpansionContext;
+
+// Строки #define, найденные потоком; указывают прямо в отображённый файл.
+// Имя и значение разбираются только если таблицы нет в кеше
+typedef struct {
+    const char *line;
+    size_t line_length;
+    uint64_t line_hash;
+    const char *name;
+    size_t name_length;
+    const char *value;
+    size_t value_length;
+} DefineEntry;
+
 typedef enum {
     SUCCESS = 0,
     ERROR_MEMORY_ALLOCATION,
@@ -30,316 +122,950 @@ typedef enum {
     ERROR_HASH_TABLE_FULL
 } StatusCode;
 
-size_t hash_function(const char *str, size_t table_size) {
-    size_t hash = 0;
-    int c;
-
-    while ((c = *str++)) {
-        if (isspace(c)) continue;
-        if (isdigit(c)) {
-            hash = hash * 62 + ((size_t) (c - '0'));
-        } else if (isupper(c)) {
-            hash = hash * 62 + ((size_t) (c - 'A' + 10));
-        } else if (islower(c)) {
-            hash = hash * 62 + ((size_t) (c - 'a' + 36));
+// Файл кеша: заголовок, затем слоты и арена как есть. Внутри только смещения,
+// поэтому таблицу можно использовать прямо из отображения по любому адресу.
+// checksum покрывает слоты и арену
+typedef struct {
+    char magic[4];
+    uint32_t slot_size;
+    uint64_t key;
+    uint64_t define_count;
+    uint64_t size;
+    uint64_t count;
+    uint64_t rehash_count;
+    uint64_t arena_size;
+    uint64_t checksum;
+} MacroCacheHeader;
+
+// Кусок файла, выровненный по строкам: в первой фазе собирает дефайны, во второй — вывод
+typedef struct {
+    HashTable *ht;
+    const char *begin;
+    const char *end;
+    DefineEntry *defines;
+    size_t define_count;
+    size_t define_capacity;
+    StringArena output;
+    StatusCode status;
+} ChunkTask;
+
+static uint64_t rotl64(uint64_t value, unsigned shift) {
+    return (value << shift) | (value >> (64 - shift));
+}
+
+static uint64_t read_u64(const char *p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t read_u32(const char *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// Ветка коротких строк xxHash64: по 8 байт, хвост по 4 и по 1, затем перемешивание.
+// Все биты результата зависят от всех байтов, поэтому маска по младшим битам безопасна
+uint64_t hash_function(const char *str, size_t length) {
+    uint64_t hash = HASH_PRIME5 + (uint64_t) length;
+
+    for (; length >= 8; str += 8, length -= 8) {
+        uint64_t k = rotl64(read_u64(str) * HASH_PRIME2, 31) * HASH_PRIME1;
+        hash = rotl64(hash ^ k, 27) * HASH_PRIME1 + HASH_PRIME4;
+    }
+    if (length >= 4) {
+        hash = rotl64(hash ^ (read_u32(str) * HASH_PRIME1), 23) * HASH_PRIME2 + HASH_PRIME3;
+        str += 4;
+        length -= 4;
+    }
+    for (; length > 0; str++, length--) {
+        hash = rotl64(hash ^ ((unsigned char) *str * HASH_PRIME5), 11) * HASH_PRIME1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= HASH_PRIME2;
+    hash ^= hash >> 29;
+    hash *= HASH_PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+StatusCode arena_reserve(StringArena *arena, size_t extra) {
+    if (arena->size + extra > arena->capacity) {
+        size_t new_capacity = arena->capacity ? arena->capacity : INITIAL_ARENA_SIZE;
+        while (arena->size + extra > new_capacity) {
+            new_capacity *= 2;
         }
+        char *new_data = realloc(arena->data, new_capacity);
+        if (!new_data) {
+            return ERROR_MEMORY_ALLOCATION;
+        }
+        arena->data = new_data;
+        arena->capacity = new_capacity;
+    }
+    return SUCCESS;
+}
+
+// Дописывает строку без завершающего нуля — используется как растущий буфер вывода
+StatusCode arena_write(StringArena *arena, const char *str, size_t length) {
+    if (length == 0) {
+        return SUCCESS;
+    }
+    StatusCode status = arena_reserve(arena, length);
+    if (status != SUCCESS) {
+        return status;
+    }
+    memcpy(arena->data + arena->size, str, length);
+    arena->size += length;
+    return SUCCESS;
+}
+
+StatusCode arena_append(StringArena *arena, const char *str, size_t length, size_t *offset) {
+    StatusCode status = arena_reserve(arena, length + 1);
+    if (status != SUCCESS) {
+        return status;
     }
 
-    return hash % table_size;
+    if (length > 0) {
+        memcpy(arena->data + arena->size, str, length);
+    }
+    arena->data[arena->size + length] = '\0';
+    *offset = arena->size;
+    arena->size += length + 1;
+    return SUCCESS;
 }
 
 StatusCode create_hash_table(HashTable *ht, size_t size) {
-    ht->table = calloc(size, sizeof(MacroNode *));
-    if (!ht->table) {
+    ht->slots = calloc(size, sizeof(MacroSlot));
+    if (!ht->slots) {
         return ERROR_MEMORY_ALLOCATION;
     }
 
     ht->size = size;
     ht->count = 0;
+    ht->rehash_count = 0;
+    ht->mapping = NULL;
+    ht->mapping_size = 0;
+    ht->expansions = NULL;
+    ht->arena.data = NULL;
+    ht->arena.size = 0;
+    ht->arena.capacity = 0;
     return SUCCESS;
 }
 
+static void free_expansions(HashTable *ht) {
+    if (!ht->expansions) {
+        return;
+    }
+    for (size_t i = 0; i < ht->size; i++) {
+        free(atomic_load_explicit(&ht->expansions[i], memory_order_relaxed));
+    }
+    free(ht->expansions);
+    ht->expansions = NULL;
+}
+
 void free_hash_table(HashTable *ht) {
     if (!ht) {
         return;
     }
-    for (size_t i = 0; i < ht->size; i++) {
-        MacroNode *current = ht->table[i];
-        while (current) {
-            MacroNode *next = current->next;
-            free(current->name);
-            free(current->value);
-            free(current);
-            current = next;
-        }
+    free_expansions(ht);
+    if (ht->mapping) {
+        munmap(ht->mapping, ht->mapping_size);
+        ht->mapping = NULL;
+        ht->mapping_size = 0;
+    } else {
+        free(ht->slots);
+        free(ht->arena.data);
     }
-    free(ht->table);
-    ht->table = NULL;
+    ht->slots = NULL;
+    ht->arena.data = NULL;
+    ht->arena.size = 0;
+    ht->arena.capacity = 0;
     ht->size = 0;
     ht->count = 0;
 }
 
-StatusCode insert_macro(HashTable *ht, const char *name, const char *value) {
-
-    unsigned long hash = (unsigned long) hash_function(name, ht->size);
+// Вставка Robin Hood: элемент, ушедший дальше от своего слота, вытесняет более "богатого"
+static void place_slot(HashTable *ht, MacroSlot slot) {
+    size_t mask = ht->size - 1;
+    size_t i = (size_t) (slot.hash & mask);
+    slot.distance = 1;
 
-    MacroNode *current = ht->table[hash];
-    while (current) {
-        if (strcmp(current->name, name) == 0) {
-            char *new_value = strdup(value);
-            if (!new_value) {
-                return ERROR_MEMORY_ALLOCATION;
-            }
-            free(current->value);
-            current->value = new_value;
-            return SUCCESS;
+    while (ht->slots[i].distance != 0) {
+        if (ht->slots[i].distance < slot.distance) {
+            MacroSlot displaced = ht->slots[i];
+            ht->slots[i] = slot;
+            slot = displaced;
         }
-        current = current->next;
+        i = (i + 1) & mask;
+        slot.distance++;
     }
+    ht->slots[i] = slot;
+}
 
-    MacroNode *new_node = malloc(sizeof(MacroNode));
-    if (!new_node) {
+static StatusCode grow_hash_table(HashTable *ht) {
+    MacroSlot *old_slots = ht->slots;
+    size_t old_size = ht->size;
+
+    ht->slots = calloc(old_size * 2, sizeof(MacroSlot));
+    if (!ht->slots) {
+        ht->slots = old_slots;
         return ERROR_MEMORY_ALLOCATION;
     }
+    ht->size = old_size * 2;
+    ht->rehash_count++;
 
-    new_node->name = strdup(name);
-    new_node->value = strdup(value);
-    if (!new_node->name || !new_node->value) {
-        free(new_node->name);
-        free(new_node->value);
-        free(new_node);
-        return ERROR_MEMORY_ALLOCATION;
+    for (size_t i = 0; i < old_size; i++) {
+        if (old_slots[i].distance != 0) {
+            place_slot(ht, old_slots[i]);
+        }
     }
+    free(old_slots);
+    return SUCCESS;
+}
 
-    new_node->next = ht->table[hash];
-    ht->table[hash] = new_node;
-    ht->count++;
+static MacroSlot *find_slot(const HashTable *ht, const char *name, size_t name_length, uint64_t hash) {
+    size_t mask = ht->size - 1;
+    size_t i = (size_t) (hash & mask);
 
-    return SUCCESS;
+    for (size_t distance = 1; ht->slots[i].distance >= distance; distance++) {
+        MacroSlot *slot = &ht->slots[i];
+        if (slot->hash == hash && slot->name_length == name_length &&
+            memcmp(ht->arena.data + slot->name_offset, name, name_length) == 0) {
+            return slot;
+        }
+        i = (i + 1) & mask;
+    }
+    return NULL;
 }
 
-const char *find_macro(const HashTable *ht, const char *name) {
+StatusCode insert_macro(HashTable *ht, const char *name, size_t name_length,
+                        const char *value, size_t value_length) {
+    uint64_t hash = hash_function(name, name_length);
+    size_t value_offset;
 
-    unsigned long hash = (unsigned long) hash_function(name, ht->size);
-    MacroNode *current = ht->table[hash];
+    StatusCode status = arena_append(&ht->arena, value, value_length, &value_offset);
+    if (status != SUCCESS) {
+        return status;
+    }
 
-    while (current) {
-        if (strcmp(current->name, name) == 0) {
-            return current->value;
+    // переопределение: старое значение остаётся в арене, слот указывает на новое
+    MacroSlot *existing = find_slot(ht, name, name_length, hash);
+    if (existing) {
+        existing->value_offset = value_offset;
+        existing->value_length = value_length;
+        return SUCCESS;
+    }
+
+    if ((ht->count + 1) * 100 > ht->size * MAX_LOAD_PERCENT) {
+        status = grow_hash_table(ht);
+        if (status != SUCCESS) {
+            return status;
         }
-        current = current->next;
     }
 
-    return NULL;
+    MacroSlot slot = {hash, 0, 0, name_length, value_offset, value_length, 0, 0, EXPANSION_NONE};
+    status = arena_append(&ht->arena, name, name_length, &slot.name_offset);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    place_slot(ht, slot);
+    ht->count++;
+    return SUCCESS;
 }
 
+// Указатель живёт до следующей вставки: арена может переехать при росте
+const char *find_macro(const HashTable *ht, const char *name) {
+    size_t name_length = strlen(name);
+    const MacroSlot *slot = find_slot(ht, name, name_length, hash_function(name, name_length));
+    return slot ? ht->arena.data + slot->value_offset : NULL;
+}
 
-StatusCode rebalance_if_needed(HashTable *ht) {
-    size_t min_chain = SIZE_MAX;
-    size_t max_chain = 0;
+// Длина пробы слота — его distance: столько сравнений нужно, чтобы найти макрос
+void print_hash_stats(const HashTable *ht, FILE *stream) {
+    size_t histogram[PROBE_HISTOGRAM_SIZE] = {0};
+    size_t total_probes = 0;
+    size_t max_probe = 0;
 
     for (size_t i = 0; i < ht->size; i++) {
-        size_t chain_length = 0;
-        MacroNode *current = ht->table[i];
-        while (current) {
-            chain_length++;
-            current = current->next;
+        size_t distance = ht->slots[i].distance;
+        if (distance == 0) {
+            continue;
         }
-        if (chain_length < min_chain) {
-            min_chain = chain_length;
+        total_probes += distance;
+        if (distance > max_probe) {
+            max_probe = distance;
         }
-        if (chain_length > max_chain) {
-            max_chain = chain_length;
+        histogram[distance < PROBE_HISTOGRAM_SIZE ? distance - 1 : PROBE_HISTOGRAM_SIZE - 1]++;
+    }
+
+    fprintf(stream, "macros: %zu, table size: %zu, load factor: %.3f, rehashes: %zu, arena: %zu bytes\n",
+            ht->count, ht->size, ht->size ? (double) ht->count / (double) ht->size : 0.0,
+            ht->rehash_count, ht->arena.size);
+    fprintf(stream, "probe length: mean %.3f, max %zu\n",
+            ht->count ? (double) total_probes / (double) ht->count : 0.0, max_probe);
+    for (size_t i = 0; i < PROBE_HISTOGRAM_SIZE; i++) {
+        fprintf(stream, "  %zu%s: %zu\n", i + 1, i + 1 == PROBE_HISTOGRAM_SIZE ? "+" : "", histogram[i]);
+    }
+}
+
+static int is_word_char(char c) {
+    return isalnum((unsigned char) c) || c == '_';
+}
+
+// Строка не обязана заканчиваться нулём: это кусок отображённого файла
+StatusCode process_define(const char *line, size_t length, DefineEntry *entry) {
+    const char *end = line + length;
+    const char *start = line + 7;
+    while (start < end && isspace((unsigned char) *start)) start++;
+
+    if (start == end || (!isalpha((unsigned char) *start) && *start != '_')) {
+        return ERROR_INVALID_DEFINE;
+    }
+    entry->name = start;
+    while (start < end && is_word_char(*start)) start++;
+    entry->name_length = (size_t) (start - entry->name);
+
+    while (start < end && isspace((unsigned char) *start)) start++;
+
+    entry->value = start;
+    while (start < end && *start != '\n' && *start != '\r') start++;
+    while (start > entry->value && isspace((unsigned char) *(start - 1))) start--;
+    entry->value_length = (size_t) (start - entry->value);
+
+    if (entry->value_length == 0) {
+        return ERROR_INVALID_DEFINE;
+    }
+    return SUCCESS;
+}
+
+static size_t slot_index(const ExpansionContext *ctx, const MacroSlot *slot) {
+    return (size_t) (slot - ctx->ht->slots);
+}
+
+static int is_expanding(const ExpansionContext *ctx, const MacroSlot *slot) {
+    size_t index = slot_index(ctx, slot);
+    return (ctx->active[index / CHAR_BIT] >> (index % CHAR_BIT)) & 1;
+}
+
+static void set_expanding(ExpansionContext *ctx, const MacroSlot *slot, int expanding) {
+    size_t index = slot_index(ctx, slot);
+    unsigned char bit = (unsigned char) (1u << (index % CHAR_BIT));
+    if (expanding) {
+        ctx->active[index / CHAR_BIT] |= bit;
+    } else {
+        ctx->active[index / CHAR_BIT] &= (unsigned char) ~bit;
+    }
+}
+
+static StatusCode push_frame(ExpansionContext *ctx, const MacroSlot *slot, const char *text, size_t length,
+                             size_t output_start) {
+    if (ctx->depth == ctx->capacity) {
+        size_t new_capacity = ctx->capacity ? ctx->capacity * 2 : 16;
+        ExpansionFrame *new_stack = realloc(ctx->stack, new_capacity * sizeof(*new_stack));
+        if (!new_stack) {
+            return ERROR_MEMORY_ALLOCATION;
+        }
+        ctx->stack = new_stack;
+        ctx->capacity = new_capacity;
+    }
+    ctx->stack[ctx->depth++] = (ExpansionFrame) {slot, text, length, 0, output_start, 0};
+    if (slot) {
+        set_expanding(ctx, slot, 1);
+    }
+    return SUCCESS;
+}
+
+// Готовое раскрытие: из кеша (в арене) или найденное второй фазой
+static const char *known_expansion(const HashTable *ht, const MacroSlot *slot, size_t *length) {
+    if (slot->state == EXPANSION_DONE) {
+        *length = slot->expansion_length;
+        return ht->arena.data + slot->expansion_offset;
+    }
+    const MacroExpansion *expansion = ht->expansions
+                                      ? atomic_load_explicit(&ht->expansions[slot - ht->slots], memory_order_acquire)
+                                      : NULL;
+    if (!expansion) {
+        return NULL;
+    }
+    *length = expansion->length;
+    return expansion->data;
+}
+
+// Если другой поток успел раньше, его копия равна нашей и наша просто выбрасывается.
+// В цепочке каждый уровень держит раскрытие всех нижних, поэтому общий объём ограничен:
+// сверх него макросы раскрываются заново, что стоит столько же, сколько их вывод
+static void publish_expansion(HashTable *ht, const MacroSlot *slot, const char *data, size_t length) {
+    size_t used = atomic_fetch_add_explicit(&ht->expansion_bytes, length, memory_order_relaxed);
+    if (used > MAX_EXPANSION_BYTES || length > MAX_EXPANSION_BYTES - used) {
+        atomic_fetch_sub_explicit(&ht->expansion_bytes, length, memory_order_relaxed);
+        return;
+    }
+    MacroExpansion *expansion = malloc(sizeof(MacroExpansion) + length);
+    if (!expansion) {
+        return;
+    }
+    expansion->length = length;
+    memcpy(expansion->data, data, length);
+    MacroExpansion *expected = NULL;
+    if (!atomic_compare_exchange_strong_explicit(&ht->expansions[slot - ht->slots], &expected, expansion,
+                                                 memory_order_release, memory_order_relaxed)) {
+        free(expansion);
+    }
+}
+
+// Раскрывает строку тела за один проход токенизации. Вложенные макросы пишут прямо в out,
+// поэтому вывод каждого кадра — непрерывный кусок out начиная с output_start,
+// и по завершении кадра он запоминается для любого уровня вложенности.
+// Значения макросов во второй фазе не двигаются: арена дописывается только после неё
+static StatusCode expand_text(ExpansionContext *ctx, const char *text, size_t length, StringArena *out) {
+    HashTable *ht = ctx->ht;
+    if (!ctx->active) {
+        ctx->active = calloc(ht->size / CHAR_BIT + 1, 1);
+        if (!ctx->active) {
+            return ERROR_MEMORY_ALLOCATION;
         }
     }
+    ctx->depth = 0;
+    StatusCode status = push_frame(ctx, NULL, text, length, out->size);
+
+    while (status == SUCCESS && ctx->depth > 0) {
+        ExpansionFrame *frame = &ctx->stack[ctx->depth - 1];
+
+        if (frame->position == frame->length) {
+            ctx->depth--;
+            if (frame->slot) {
+                set_expanding(ctx, frame->slot, 0);
+            }
+            // Раскрытие, в котором сработала защита от цикла, зависит от точки входа — его не кешируем
+            if (frame->slot && !frame->cyclic && ht->expansions) {
+                publish_expansion(ht, frame->slot, out->data + frame->output_start, out->size - frame->output_start);
+            }
+            if (ctx->depth > 0) {
+                ctx->stack[ctx->depth - 1].cyclic |= frame->cyclic;
+            }
+            continue;
+        }
+
+        const char *current = frame->text;
+        size_t start = frame->position;
+        size_t pos = start;
+
+        if (!is_word_char(current[pos])) {
+            while (pos < frame->length && !is_word_char(current[pos])) pos++;
+            frame->position = pos;
+            status = arena_write(out, current + start, pos - start);
+            continue;
+        }
 
-    if (max_chain >= 2 && min_chain * 2 <= max_chain) {
-        size_t new_size;
+        while (pos < frame->length && is_word_char(current[pos])) pos++;
+        frame->position = pos;
+        size_t word_length = pos - start;
+        MacroSlot *slot = find_slot(ht, current + start, word_length, hash_function(current + start, word_length));
+        size_t expansion_length = 0;
+        const char *expansion = slot ? known_expansion(ht, slot, &expansion_length) : NULL;
 
-        if (max_chain > ht->count / 2) {
-            new_size = ht->size * 2;
+        if (!slot) {
+            status = arena_write(out, current + start, word_length);
+        } else if (expansion) {
+            status = arena_write(out, expansion, expansion_length);
+        } else if (is_expanding(ctx, slot)) {
+            // Макрос, уже раскрываемый выше по стеку, оставляем как есть — иначе цикл
+            frame->cyclic = 1;
+            status = arena_write(out, current + start, word_length);
         } else {
-            new_size = ht->size / 2;
+            status = push_frame(ctx, slot, ht->arena.data + slot->value_offset, slot->value_length, out->size);
         }
+    }
 
-        if (new_size < MIN_HASHSIZE) new_size = MIN_HASHSIZE;
-        if (new_size > MAX_HASHSIZE) new_size = MAX_HASHSIZE;
+    // После ошибки на стеке остаются кадры — снимаем их отметки
+    for (; ctx->depth > 0; ctx->depth--) {
+        if (ctx->stack[ctx->depth - 1].slot) {
+            set_expanding(ctx, ctx->stack[ctx->depth - 1].slot, 0);
+        }
+    }
+    return status;
+}
 
-        HashTable new_ht;
-        StatusCode status = create_hash_table(&new_ht, new_size);
-        if (status != SUCCESS) {
-            return status;
+// Готовит таблицу ко второй фазе: раскрытия будут считаться по первому обращению
+static StatusCode prepare_expansions(HashTable *ht) {
+    ht->expansions = malloc(ht->size * sizeof(*ht->expansions));
+    if (!ht->expansions) {
+        return ERROR_MEMORY_ALLOCATION;
+    }
+    for (size_t i = 0; i < ht->size; i++) {
+        atomic_init(&ht->expansions[i], NULL);
+    }
+    atomic_init(&ht->expansion_bytes, 0);
+    return SUCCESS;
+}
+
+// Переносит раскрытия второй фазы в арену, чтобы они попали в кеш
+static StatusCode store_expansions(HashTable *ht) {
+    StatusCode status = SUCCESS;
+    for (size_t i = 0; i < ht->size && status == SUCCESS; i++) {
+        MacroExpansion *expansion = atomic_load_explicit(&ht->expansions[i], memory_order_relaxed);
+        if (expansion && ht->slots[i].state != EXPANSION_DONE) {
+            status = arena_append(&ht->arena, expansion->data, expansion->length, &ht->slots[i].expansion_offset);
+            if (status == SUCCESS) {
+                ht->slots[i].expansion_length = expansion->length;
+                ht->slots[i].state = EXPANSION_DONE;
+            }
         }
+    }
+    free_expansions(ht);
+    return status;
+}
 
-        for (size_t i = 0; i < ht->size; i++) {
-            MacroNode *current = ht->table[i];
-            while (current) {
-                status = insert_macro(&new_ht, current->name, current->value);
-                if (status != SUCCESS) {
-                    free_hash_table(&new_ht);
-                    return status;
+static const char *skip_leading_spaces(const char *line, const char *line_end) {
+    while (line < line_end && isspace((unsigned char) *line)) line++;
+    return line;
+}
+
+static int is_define_line(const char *line, const char *line_end) {
+    return line_end - line >= 7 && strncmp(line, "#define", 7) == 0;
+}
+
+static void *scan_defines_worker(void *arg) {
+    ChunkTask *task = arg;
+    const char *line = task->begin;
+
+    while (line < task->end && task->status == SUCCESS) {
+        const char *newline = memchr(line, '\n', (size_t) (task->end - line));
+        const char *line_end = newline ? newline + 1 : task->end;
+
+        // Удаляем пробелы
+        const char *trimmed_line = skip_leading_spaces(line, line_end);
+
+        // Начинается ли с дефайна
+        if (is_define_line(trimmed_line, line_end)) {
+            if (task->define_count == task->define_capacity) {
+                size_t new_capacity = task->define_capacity ? task->define_capacity * 2 : 64;
+                DefineEntry *new_defines = realloc(task->defines, new_capacity * sizeof(DefineEntry));
+                if (!new_defines) {
+                    task->status = ERROR_MEMORY_ALLOCATION;
+                    break;
                 }
-                current = current->next;
+                task->defines = new_defines;
+                task->define_capacity = new_capacity;
             }
+            DefineEntry *entry = &task->defines[task->define_count++];
+            entry->line = trimmed_line;
+            entry->line_length = (size_t) (line_end - trimmed_line);
+            entry->line_hash = hash_function(entry->line, entry->line_length);
         }
+        line = line_end;
+    }
+    return NULL;
+}
+
+static void *expand_chunk_worker(void *arg) {
+    ChunkTask *task = arg;
+    ExpansionContext ctx = {task->ht, NULL, 0, 0, NULL};
+    const char *line = task->begin;
 
-        free_hash_table(ht);
-        *ht = new_ht;
+    task->output.size = 0;
+    while (line < task->end && task->status == SUCCESS) {
+        const char *newline = memchr(line, '\n', (size_t) (task->end - line));
+        const char *line_end = newline ? newline + 1 : task->end;
+        const char *trimmed_line = skip_leading_spaces(line, line_end);
+
+        if (!is_define_line(trimmed_line, line_end)) {
+            task->status = expand_text(&ctx, trimmed_line, (size_t) (line_end - trimmed_line), &task->output);
+        }
+        line = line_end;
     }
 
-    return SUCCESS;
+    free(ctx.stack);
+    free(ctx.active);
+    return NULL;
 }
 
-StatusCode process_define(char *line, HashTable *ht) {
-    char name[MAX_MACRO_LENGTH] = {0};
-    char value[MAX_MACRO_LENGTH] = {0};
+// Первая задача выполняется в текущем потоке, если поток создать не удалось — тоже
+static void run_tasks(ChunkTask *tasks, size_t count, void *(*worker)(void *)) {
+    pthread_t threads[MAX_THREADS];
+    int started[MAX_THREADS] = {0};
 
-    char *start = line + 7;
-    while (*start && isspace(*start)) start++;
-
-    char *ptr = name;
-    if (!isalpha(*start) && *start != '_') {
-        return ERROR_INVALID_DEFINE;
+    for (size_t i = 1; i < count; i++) {
+        started[i] = pthread_create(&threads[i], NULL, worker, &tasks[i]) == 0;
+        if (!started[i]) {
+            worker(&tasks[i]);
+        }
     }
-    while (*start && (isalnum(*start) || *start == '_')) {
-        if (ptr - name >= MAX_MACRO_LENGTH - 1) {
-            return ERROR_INVALID_DEFINE;
+    worker(&tasks[0]);
+    for (size_t i = 1; i < count; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
         }
-        *ptr++ = *start++;
     }
-    *ptr = '\0';
+}
+
+// Граница куска сдвигается на начало следующей строки
+static const char *align_to_line(const char *pos, const char *end) {
+    const char *newline = memchr(pos, '\n', (size_t) (end - pos));
+    return newline ? newline + 1 : end;
+}
+
+static size_t thread_count(void) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    if (online < 1) {
+        return 1;
+    }
+    return online > MAX_THREADS ? MAX_THREADS : (size_t) online;
+}
+
+// Кеш включается только явно через MACRO_CACHE_DIR: в общем каталоге вроде /tmp
+// чужой процесс мог бы подложить свою таблицу. 0 — кеш выключен
+static int macro_cache_path(char *path, size_t path_size, uint64_t key) {
+    const char *dir = getenv("MACRO_CACHE_DIR");
+    if (!dir || !*dir) {
+        return 0;
+    }
+    int length = snprintf(path, path_size, "%s/macros-%016llx.mct", dir, (unsigned long long) key);
+    return length > 0 && (size_t) length < path_size;
+}
 
-    while (*start && isspace(*start)) start++;
+static uint64_t macro_cache_checksum(const MacroSlot *slots, size_t size, const char *arena, size_t arena_size) {
+    return rotl64(hash_function((const char *) slots, size * sizeof(MacroSlot)), 32) ^
+           hash_function(arena, arena_size);
+}
 
-    ptr = value;
-    while (*start && *start != '\n' && *start != '\r') {
-        if (ptr - value >= MAX_MACRO_LENGTH - 1) {
-            return ERROR_INVALID_DEFINE;
+// Строка в арене: лежит целиком внутри и заканчивается нулём, как её пишет arena_append
+static int arena_span_valid(const char *arena, size_t arena_size, size_t offset, size_t length) {
+    return offset < arena_size && length < arena_size - offset && arena[offset + length] == '\0';
+}
+
+// Проверяет каждый занятый слот: строки внутри арены, хеш совпадает с именем,
+// distance согласован с позицией. Иначе поиск по таблице читал бы за её пределами
+static int macro_slots_valid(const MacroSlot *slots, size_t size, size_t count,
+                             const char *arena, size_t arena_size) {
+    size_t occupied = 0;
+    for (size_t i = 0; i < size; i++) {
+        const MacroSlot *slot = &slots[i];
+        if (slot->distance == 0) {
+            continue;
+        }
+        occupied++;
+        if (slot->distance > size || ((i - (size_t) slot->hash) & (size - 1)) != slot->distance - 1 ||
+            !arena_span_valid(arena, arena_size, slot->name_offset, slot->name_length) ||
+            !arena_span_valid(arena, arena_size, slot->value_offset, slot->value_length) ||
+            slot->hash != hash_function(arena + slot->name_offset, slot->name_length)) {
+            return 0;
+        }
+        if (slot->state == EXPANSION_DONE) {
+            if (!arena_span_valid(arena, arena_size, slot->expansion_offset, slot->expansion_length)) {
+                return 0;
+            }
+        } else if (slot->state != EXPANSION_NONE) {
+            return 0;
         }
-        *ptr++ = *start++;
     }
-    *ptr = '\0';
+    return occupied == count;
+}
 
-    while (ptr > value && isspace(*(ptr - 1))) {
-        *(--ptr) = '\0';
+// Любая несостыковка — просто промах кеша, таблица строится заново.
+// Файл должен принадлежать текущему пользователю
+static int load_macro_cache(HashTable *ht, const char *path, uint64_t key, size_t define_count) {
+    int fd = open(path, O_RDONLY | O_NOFOLLOW);
+    if (fd == -1) {
+        return 0;
     }
 
-    if (name[0] == '\0' || value[0] == '\0') {
-        return ERROR_INVALID_DEFINE;
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1 || !S_ISREG(file_stat.st_mode) || file_stat.st_uid != geteuid() ||
+        (size_t) file_stat.st_size < sizeof(MacroCacheHeader)) {
+        close(fd);
+        return 0;
+    }
+    size_t file_size = (size_t) file_stat.st_size;
+
+    void *mapping = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return 0;
+    }
+
+    const MacroCacheHeader *header = mapping;
+    size_t payload_size = file_size - sizeof(MacroCacheHeader);
+    if (memcmp(header->magic, MACRO_CACHE_MAGIC, 4) != 0 || header->slot_size != sizeof(MacroSlot) ||
+        header->key != key || header->define_count != define_count ||
+        header->size == 0 || (header->size & (header->size - 1)) != 0 ||
+        header->size > payload_size / sizeof(MacroSlot) ||
+        header->arena_size != payload_size - (size_t) header->size * sizeof(MacroSlot)) {
+        munmap(mapping, file_size);
+        return 0;
+    }
+
+    const MacroSlot *slots = (const MacroSlot *) ((const char *) mapping + sizeof(MacroCacheHeader));
+    size_t slots_size = (size_t) header->size * sizeof(MacroSlot);
+    const char *arena = (const char *) slots + slots_size;
+    if (header->checksum != macro_cache_checksum(slots, (size_t) header->size, arena, (size_t) header->arena_size) ||
+        !macro_slots_valid(slots, (size_t) header->size, (size_t) header->count, arena,
+                           (size_t) header->arena_size)) {
+        munmap(mapping, file_size);
+        return 0;
     }
 
-    return insert_macro(ht, name, value);
+    free_hash_table(ht);
+    ht->slots = (MacroSlot *) ((char *) mapping + sizeof(MacroCacheHeader));
+    ht->size = (size_t) header->size;
+    ht->count = (size_t) header->count;
+    ht->rehash_count = (size_t) header->rehash_count;
+    ht->arena.data = (char *) ht->slots + slots_size;
+    ht->arena.size = (size_t) header->arena_size;
+    ht->arena.capacity = ht->arena.size;
+    ht->mapping = mapping;
+    ht->mapping_size = file_size;
+    return 1;
 }
 
-StatusCode process_file(const char *filename) {
-    FILE *file = fopen(filename, "r");
+// Пишем во временный файл и переименовываем, чтобы параллельные запуски не видели половину таблицы
+static void save_macro_cache(const HashTable *ht, const char *path, uint64_t key, size_t define_count) {
+    char temp_path[PATH_MAX];
+    if (snprintf(temp_path, sizeof(temp_path), "%s.%ld.tmp", path, (long) getpid()) >= (int) sizeof(temp_path)) {
+        return;
+    }
+
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW, 0600);
+    if (fd == -1) {
+        return;
+    }
+    FILE *file = fdopen(fd, "wb");
     if (!file) {
-        return ERROR_FILE_OPERATION;
+        close(fd);
+        remove(temp_path);
+        return;
     }
 
-    HashTable ht;
-    StatusCode status = create_hash_table(&ht, INITIAL_HASHSIZE);
-    if (status != SUCCESS) {
-        fclose(file);
-        return status;
+    MacroCacheHeader header = {MACRO_CACHE_MAGIC_INIT, (uint32_t) sizeof(MacroSlot), key, define_count,
+                               ht->size, ht->count, ht->rehash_count, ht->arena.size,
+                               macro_cache_checksum(ht->slots, ht->size, ht->arena.data, ht->arena.size)};
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(ht->slots, sizeof(MacroSlot), ht->size, file) == ht->size &&
+             fwrite(ht->arena.data, 1, ht->arena.size, file) == ht->arena.size;
+    ok = fclose(file) == 0 && ok;
+
+    if (!ok || rename(temp_path, path) != 0) {
+        remove(temp_path);
     }
+}
 
-    char line[MAX_MACRO_LENGTH];
+// Ключ кеша — хеш всех строк #define по порядку, независимо от разбиения на куски
+static uint64_t define_section_key(const ChunkTask *tasks, size_t count, size_t *define_count) {
+    uint64_t key = HASH_PRIME5;
+    *define_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = 0; j < tasks[i].define_count; j++) {
+            key = rotl64(key ^ tasks[i].defines[j].line_hash, 29) * HASH_PRIME1 + HASH_PRIME4;
+        }
+        *define_count += tasks[i].define_count;
+    }
+    return key;
+}
 
-    while (fgets(line, sizeof(line), file)) {
-        // Удаляем пробелы
-        char *trimmed_line = line;
-        while (*trimmed_line && isspace(*trimmed_line)) {
-            trimmed_line++;
+// key и define_count нужны, чтобы после второй фазы сохранить таблицу в кеш
+static StatusCode build_macro_table(HashTable *ht, const char *data, size_t size, size_t threads, int *from_cache,
+                                    uint64_t *key, size_t *define_count) {
+    ChunkTask tasks[MAX_THREADS];
+    size_t count = size < MIN_PARALLEL_SIZE ? 1 : threads;
+    const char *end = data + size;
+    const char *begin = data;
+
+    for (size_t i = 0; i < count; i++) {
+        const char *chunk_end = i + 1 == count ? end : align_to_line(data + size / count * (i + 1), end);
+        if (chunk_end < begin) {
+            chunk_end = begin;
         }
+        tasks[i] = (ChunkTask) {ht, begin, chunk_end, NULL, 0, 0, {NULL, 0, 0}, SUCCESS};
+        begin = chunk_end;
+    }
 
-        // Начинается ли с дефайна
-        if (strncmp(trimmed_line, "#define", 7) == 0) {
-            status = process_define(trimmed_line, &ht);
-            if (status != SUCCESS) {
-                free_hash_table(&ht);
-                fclose(file);
-                return status;
-            }
+    run_tasks(tasks, count, scan_defines_worker);
 
-            status = rebalance_if_needed(&ht);
-            if (status != SUCCESS) {
-                free_hash_table(&ht);
-                fclose(file);
-                return status;
+    StatusCode status = SUCCESS;
+    for (size_t i = 0; i < count && status == SUCCESS; i++) {
+        status = tasks[i].status;
+    }
+
+    *key = define_section_key(tasks, count, define_count);
+    char path[PATH_MAX];
+    *from_cache = status == SUCCESS && *define_count > 0 && macro_cache_path(path, sizeof(path), *key) &&
+                  load_macro_cache(ht, path, *key, *define_count);
+
+    // Вставляем в порядке файла, чтобы переопределения работали как раньше
+    for (size_t i = 0; i < count && status == SUCCESS && !*from_cache; i++) {
+        for (size_t j = 0; j < tasks[i].define_count && status == SUCCESS; j++) {
+            DefineEntry *entry = &tasks[i].defines[j];
+            status = process_define(entry->line, entry->line_length, entry);
+            if (status == SUCCESS) {
+                status = insert_macro(ht, entry->name, entry->name_length, entry->value, entry->value_length);
             }
         }
     }
 
-    rewind(file);
+    for (size_t i = 0; i < count; i++) {
+        free(tasks[i].defines);
+    }
+    return status;
+}
 
-    while (fgets(line, sizeof(line), file)) {
-        char *trimmed_line = line;
-        while (*trimmed_line && isspace(*trimmed_line)) {
-            trimmed_line++;
-        }
+static StatusCode expand_body(HashTable *ht, const char *data, size_t size, size_t threads) {
+    ChunkTask tasks[MAX_THREADS];
+    const char *end = data + size;
+    const char *pos = data;
+    StatusCode status = SUCCESS;
 
-        if (strncmp(trimmed_line, "#define", 7) == 0) {
-            continue;
+    for (size_t i = 0; i < threads; i++) {
+        tasks[i] = (ChunkTask) {ht, NULL, NULL, NULL, 0, 0, {NULL, 0, 0}, SUCCESS};
+    }
+
+    // Куски обрабатываются раундами, вывод пишется по порядку — память не растёт с размером файла
+    while (pos < end && status == SUCCESS) {
+        size_t count = 0;
+        while (count < threads && pos < end) {
+            const char *chunk_end = (size_t) (end - pos) <= EXPAND_CHUNK_SIZE
+                                    ? end : align_to_line(pos + EXPAND_CHUNK_SIZE, end);
+            tasks[count].begin = pos;
+            tasks[count].end = chunk_end;
+            pos = chunk_end;
+            count++;
         }
 
-        char temp[MAX_MACRO_LENGTH * 2];
-        strcpy(temp, trimmed_line);
-
-        while (1) {
-            char resolved[MAX_MACRO_LENGTH * 2] = {0};
-            size_t r_pos = 0;
-            size_t pos = 0;
-            int changed = 0;
-
-            while (pos < strlen(temp)) {
-                if (isalnum(temp[pos]) || temp[pos] == '_') {
-                    char word[MAX_MACRO_LENGTH] = {0};
-                    size_t word_pos = 0;
-
-                    while (pos < strlen(temp) && (isalnum(temp[pos]) || temp[pos] == '_')) {
-                        word[word_pos++] = temp[pos++];
-                    }
-
-                    const char *replacement = find_macro(&ht, word);
-                    if (replacement) {
-                        strcpy(resolved + r_pos, replacement);
-                        r_pos += strlen(replacement);
-                        changed = 1;
-                    } else {
-                        strcpy(resolved + r_pos, word);
-                        r_pos += strlen(word);
-                    }
-                } else {
-                    resolved[r_pos++] = temp[pos++];
-                }
+        run_tasks(tasks, count, expand_chunk_worker);
+
+        for (size_t i = 0; i < count && status == SUCCESS; i++) {
+            status = tasks[i].status;
+            if (status == SUCCESS && tasks[i].output.size > 0) {
+                fwrite(tasks[i].output.data, 1, tasks[i].output.size, stdout);
             }
+        }
+    }
 
-            resolved[r_pos] = '\0';
+    for (size_t i = 0; i < threads; i++) {
+        free(tasks[i].output.data);
+    }
+    return status;
+}
 
-            if (!changed) {
-                break;
-            }
+// stats != NULL — после обработки напечатать туда состояние таблицы
+StatusCode process_file(const char *filename, FILE *stats) {
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        return ERROR_FILE_OPERATION;
+    }
 
-            strcpy(temp, resolved);
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1) {
+        close(fd);
+        return ERROR_FILE_OPERATION;
+    }
+
+    size_t size = (size_t) file_stat.st_size;
+    if (size == 0) {
+        close(fd);
+        return SUCCESS;
+    }
+
+    char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return ERROR_FILE_OPERATION;
+    }
+    posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+
+    HashTable ht;
+    StatusCode status = create_hash_table(&ht, INITIAL_HASHSIZE);
+    if (status != SUCCESS) {
+        munmap(data, size);
+        return status;
+    }
+
+    size_t threads = thread_count();
+    int from_cache = 0;
+    uint64_t key = 0;
+    size_t define_count = 0;
+    status = build_macro_table(&ht, data, size, threads, &from_cache, &key, &define_count);
+    if (status == SUCCESS) {
+        status = prepare_expansions(&ht);
+    }
+    if (status == SUCCESS) {
+        status = expand_body(&ht, data, size, threads);
+    }
+    // В кеш попадают только раскрытия, которые понадобились телу файла
+    char path[PATH_MAX];
+    if (status == SUCCESS && !from_cache && define_count > 0 && macro_cache_path(path, sizeof(path), key)) {
+        status = store_expansions(&ht);
+        if (status == SUCCESS) {
+            save_macro_cache(&ht, path, key, define_count);
+        }
+    }
+    if (status == SUCCESS && stats) {
+        fprintf(stats, "macro table: %s\n", from_cache ? "loaded from cache" : "built");
+        print_hash_stats(&ht, stats);
+    }
+
+    free_hash_table(&ht);
+    munmap(data, size);
+    return status;
+}
+
+StatusCode run_benchmark(size_t count) {
+    HashTable ht;
+    StatusCode status = create_hash_table(&ht, INITIAL_HASHSIZE);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    char name[64];
+    char value[64];
+    clock_t start = clock();
+    for (size_t i = 0; i < count; i++) {
+        snprintf(name, sizeof(name), "MACRO_%zu", i);
+        snprintf(value, sizeof(value), "(%zu)", i);
+        status = insert_macro(&ht, name, strlen(name), value, strlen(value));
+        if (status != SUCCESS) {
+            free_hash_table(&ht);
+            return status;
         }
+    }
+    double insert_ms = (double) (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
 
-        printf("%s", temp);
+    size_t found = 0;
+    start = clock();
+    for (size_t i = 0; i < count * 2; i++) {
+        snprintf(name, sizeof(name), "MACRO_%zu", i);
+        if (find_macro(&ht, name)) {
+            found++;
+        }
     }
+    double lookup_ms = (double) (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+    print_hash_stats(&ht, stdout);
+    printf("insert: %.2f ms, lookup (%zu hits of %zu): %.2f ms\n", insert_ms, found, count * 2, lookup_ms);
 
     free_hash_table(&ht);
-    fclose(file);
     return SUCCESS;
 }
 
-
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <input_file>\n", argv[0]);
+    if (argc == 3 && strcmp(argv[1], "--bench") == 0) {
+        long count = strtol(argv[2], NULL, 10);
+        if (count <= 0) {
+            fprintf(stderr, "Usage: %s --bench <count>\n", argv[0]);
+            return ERROR_INVALID_ARGS;
+        }
+        return (int) run_benchmark((size_t) count);
+    }
+
+    int with_stats = argc == 3 && strcmp(argv[1], "--stats") == 0;
+    if (argc != 2 && !with_stats) {
+        fprintf(stderr, "Usage: %s [--stats] <input_file>\n", argv[0]);
         return ERROR_INVALID_ARGS;
     }
 
-    StatusCode status = process_file(argv[1]);
+    StatusCode status = process_file(argv[argc - 1], with_stats ? stderr : NULL);
     if (status != SUCCESS) {
         const char *error_messages[] = {
                 "Success",
@@ -1,3 +1,5 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,10 +7,32 @@
 #include <time.h>
 #include <math.h>
 #include <limits.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define MAX_ARRAYS 26
 #define MAX_COMMAND_LENGTH 256
 #define INITIAL_ARRAY_CAPACITY 10
+#define MAX_TOKEN_LENGTH 255
+#define TOKEN_SAMPLE_SIZE 65536
+#define SAVE_BUFFER_SIZE 65536
+#define RADIX_SORT_THRESHOLD 256
+#define PARALLEL_SORT_THRESHOLD ((size_t) 1 << 22)
+#define MAX_SORT_THREADS 64
+#define MAX_PIPELINE_THREADS 16
+#define SAMPLE_OVERSAMPLING 64
+#define RNG_LANES 4
+#define SHUFFLE_CHUNKS 16
+#define PARALLEL_SHUFFLE_THRESHOLD ((size_t) 1 << 22)
+#define COUNTING_RANGE_MIN 65536
+#define COUNTING_RANGE_LIMIT ((uint64_t) 1 << 26)
+#define BYTECODE_MAGIC "ABC1"
+#define BYTECODE_MAGIC_INIT {'A', 'B', 'C', '1'}
 
 typedef enum {
     OK,
@@ -24,38 +48,136 @@ typedef enum {
 } StatusCode;
 
 typedef struct {
+    int min;
+    int max;
+    int min_idx;
+    int max_idx;
+    int64_t sum;
+    int most_freq;
+    int frequency;
+} ArrayStats;
+
+// Части закешированной статистики, которые сейчас верны
+#define STATS_SUM 1u
+#define STATS_MINMAX 2u
+#define STATS_INDICES 4u
+#define STATS_MODE 8u
+#define STATS_ALL (STATS_SUM | STATS_MINMAX | STATS_INDICES | STATS_MODE)
+
+// Общий буфер с подсчётом ссылок: несколько массивов могут смотреть на разные его срезы.
+// Счётчик атомарный — массивы с общим буфером могут меняться в разных потоках
+typedef struct {
+    atomic_int refcount;
+    int capacity;
+    int data[];
+} IntBuffer;
+
+// data и capacity — срез буфера начиная с offset; писать в data можно только после make_writable.
+// stats_valid говорит, что из stats ещё соответствует данным
+typedef struct {
+    IntBuffer *buffer;
+    int offset;
     int *data;
     int size;
     int capacity;
+    unsigned stats_valid;
+    ArrayStats stats;
 } Array;
 
+// Состояние xoshiro256**
+typedef struct {
+    uint64_t s[4];
+} Rng;
+
 typedef struct {
     Array arrays[MAX_ARRAYS];
     int initialized[MAX_ARRAYS];
+    Rng rngs[MAX_ARRAYS];
 } ArrayStorage;
 
+static IntBuffer *alloc_buffer(int capacity) {
+    IntBuffer *buffer = malloc(sizeof(IntBuffer) + (size_t) capacity * sizeof(int));
+    if (buffer) {
+        atomic_init(&buffer->refcount, 1);
+        buffer->capacity = capacity;
+    }
+    return buffer;
+}
+
+static void release_buffer(IntBuffer *buffer) {
+    if (buffer && atomic_fetch_sub(&buffer->refcount, 1) == 1) {
+        free(buffer);
+    }
+}
+
+static void attach_buffer(Array *array, IntBuffer *buffer, int offset) {
+    array->buffer = buffer;
+    array->offset = offset;
+    array->data = buffer ? buffer->data + offset : NULL;
+    array->capacity = buffer ? buffer->capacity - offset : 0;
+}
+
+// Массив начинает смотреть на срез чужого буфера, ничего не копируя
+void share_slice(Array *array, const Array *source, int start, int count) {
+    IntBuffer *buffer = source->buffer;
+    int offset = source->offset + start;
+    atomic_fetch_add(&buffer->refcount, 1);
+    release_buffer(array->buffer);
+    attach_buffer(array, buffer, offset);
+    array->size = count;
+}
+
+// Копирование при записи: общий буфер копируется в собственный вместимостью не меньше capacity
+static StatusCode make_unique(Array *array, int capacity) {
+    if (capacity < array->size) capacity = array->size;
+    if (capacity < INITIAL_ARRAY_CAPACITY) capacity = INITIAL_ARRAY_CAPACITY;
+
+    IntBuffer *buffer = alloc_buffer(capacity);
+    if (!buffer) return ERROR_MEMORY;
+
+    memcpy(buffer->data, array->data, (size_t) array->size * sizeof(int));
+    release_buffer(array->buffer);
+    attach_buffer(array, buffer, 0);
+    return OK;
+}
+
+StatusCode make_writable(Array *array) {
+    if (atomic_load(&array->buffer->refcount) == 1) return OK;
+    return make_unique(array, array->size);
+}
+
 StatusCode ensure_capacity(Array *array, int needed_size) {
+    if (atomic_load(&array->buffer->refcount) > 1) {
+        return make_unique(array, needed_size);
+    }
     if (needed_size <= array->capacity) return OK;
 
+    // Своё начало среза сдвигаем в начало буфера, прежде чем расти
+    if (array->offset > 0) {
+        memmove(array->buffer->data, array->data, (size_t) array->size * sizeof(int));
+        attach_buffer(array, array->buffer, 0);
+        if (needed_size <= array->capacity) return OK;
+    }
+
     int new_capacity = array->capacity;
     while (new_capacity < needed_size) {
         new_capacity *= 2;
     }
 
-    int *new_data = realloc(array->data, new_capacity * sizeof(int));
-    if (!new_data) return ERROR_MEMORY;
+    IntBuffer *new_buffer = realloc(array->buffer, sizeof(IntBuffer) + (size_t) new_capacity * sizeof(int));
+    if (!new_buffer) return ERROR_MEMORY;
 
-    array->data = new_data;
-    array->capacity = new_capacity;
+    new_buffer->capacity = new_capacity;
+    attach_buffer(array, new_buffer, 0);
     return OK;
 }
 
 int get_array_index(char name) {
-    if (!isalpha(name)) {
+    if (!isalpha((unsigned char) name)) {
         return -1;
     }
 
-    name = toupper(name);
+    name = (char) toupper((unsigned char) name);
     if (name < 'A' || name > 'Z') {
         return -1;
     }
@@ -64,381 +186,1912 @@ int get_array_index(char name) {
 }
 
 StatusCode init_array(Array *array) {
-    array->data = malloc(INITIAL_ARRAY_CAPACITY * sizeof(int));
-    if (!array->data) return ERROR_MEMORY;
+    IntBuffer *buffer = alloc_buffer(INITIAL_ARRAY_CAPACITY);
+    if (!buffer) return ERROR_MEMORY;
 
+    attach_buffer(array, buffer, 0);
     array->size = 0;
-    array->capacity = INITIAL_ARRAY_CAPACITY;
+    array->stats_valid = 0;
     return OK;
 }
 
+// Отмечает изменение массива; keep — части статистики, которые вызывающий уже поправил сам
+void array_changed(Array *array, unsigned keep) {
+    array->stats_valid &= keep;
+    if (array->size == 0) {
+        array->stats_valid = 0;
+    }
+}
+
 void free_array(Array *array) {
     if (array) {
-        free(array->data);
-        array->data = NULL;
+        release_buffer(array->buffer);
+        attach_buffer(array, NULL, 0);
         array->size = 0;
-        array->capacity = 0;
+        array->stats_valid = 0;
     }
 }
 
-StatusCode cmd_load(Array *array, const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) return ERROR_FILE_OPEN;
+int has_suffix(const char *str, const char *suffix) {
+    size_t length = strlen(str);
+    size_t suffix_length = strlen(suffix);
+    return length >= suffix_length && strcmp(str + length - suffix_length, suffix) == 0;
+}
 
-    array->size = 0;
-    char word[256];
+// Пробельные символы в смысле fscanf("%s") в локали "C"
+static int is_token_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
 
-    while (!feof(file)) {
+// То же, что strtol с проверкой *endptr == '\0' и диапазона int, но без ветвлений на каждую цифру.
+// Ведущие нули отбрасываются, после них больше 10 цифр — заведомо вне диапазона
+static int parse_int_token(const char *p, size_t length, int *value) {
+    const char *end = p + length;
+    int negative = 0;
 
-        if (fscanf(file, "%255s", word) != 1) {
-            break;
-        }
+    if (p < end && (*p == '+' || *p == '-')) {
+        negative = *p == '-';
+        p++;
+    }
+    if (p == end) return 0;
 
-        char *endptr;
-        long value = strtol(word, &endptr, 10);
+    while (p < end - 1 && *p == '0') p++;
+    if (end - p > 10) return 0;
 
-        if (*endptr != '\0' || value > INT_MAX || value < INT_MIN) {
-            continue;
-        }
+    uint64_t result = 0;
+    unsigned invalid = 0;
+    for (; p < end; p++) {
+        unsigned digit = (unsigned) (unsigned char) *p - '0';
+        invalid |= digit > 9;
+        result = result * 10 + digit;
+    }
 
-        StatusCode status = ensure_capacity(array, array->size + 1);
-        if (status != OK) {
-            fclose(file);
-            return status;
-        }
+    if (invalid || result > (uint64_t) INT_MAX + (uint64_t) negative) return 0;
+    *value = (int) (negative ? -(int64_t) result : (int64_t) result);
+    return 1;
+}
 
-        array->data[array->size++] = (int) value;
+// Оценка числа элементов по первым TOKEN_SAMPLE_SIZE байтам, чтобы не расти удвоениями
+static size_t estimate_token_count(const char *data, size_t size) {
+    size_t sample = size < TOKEN_SAMPLE_SIZE ? size : TOKEN_SAMPLE_SIZE;
+    size_t tokens = 0;
+    for (size_t i = 0; i < sample; i++) {
+        tokens += !is_token_space(data[i]) && (i == 0 || is_token_space(data[i - 1]));
     }
+    return (size_t) ((uint64_t) tokens * size / sample) + 16;
+}
 
-    fclose(file);
+static StatusCode load_text(Array *array, const char *data, size_t size) {
+    size_t estimate = estimate_token_count(data, size);
+    StatusCode status = ensure_capacity(array, estimate > INT_MAX ? INT_MAX : (int) estimate);
+    if (status != OK) return status;
+
+    size_t pos = 0;
+    while (pos < size) {
+        while (pos < size && is_token_space(data[pos])) pos++;
+        size_t start = pos;
+        while (pos < size && !is_token_space(data[pos])) pos++;
+
+        // fscanf("%255s") резал длинные слова на куски по 255 символов — режем так же
+        for (size_t piece = start; piece < pos; piece += MAX_TOKEN_LENGTH) {
+            size_t length = pos - piece < MAX_TOKEN_LENGTH ? pos - piece : MAX_TOKEN_LENGTH;
+            int value;
+            if (!parse_int_token(data + piece, length, &value)) {
+                continue;
+            }
+
+            if (array->size == array->capacity) {
+                if (array->size == INT_MAX) return ERROR_MEMORY;
+                status = ensure_capacity(array, array->size + 1);
+                if (status != OK) return status;
+            }
+            array->data[array->size++] = value;
+        }
+    }
+    return OK;
+}
+
+_Static_assert(sizeof(int) == sizeof(int32_t), ".i32 files are read straight into Array::data");
+
+// .i32 — элементы как есть, в порядке байт машины, без заголовка
+static StatusCode load_binary(Array *array, int fd, size_t size) {
+    if (size % sizeof(int32_t) != 0 || size / sizeof(int32_t) > INT_MAX) return ERROR_FILE_READ;
+
+    int count = (int) (size / sizeof(int32_t));
+    StatusCode status = ensure_capacity(array, count);
+    if (status != OK) return status;
+
+    char *dest = (char *) array->data;
+    size_t done = 0;
+    while (done < size) {
+        ssize_t got = read(fd, dest + done, size - done);
+        if (got <= 0) return ERROR_FILE_READ;
+        done += (size_t) got;
+    }
+    array->size = count;
     return OK;
 }
 
+StatusCode cmd_load(Array *array, const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) return ERROR_FILE_OPEN;
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1) {
+        close(fd);
+        return ERROR_FILE_READ;
+    }
+    size_t size = (size_t) file_stat.st_size;
+
+    array->size = 0;
+    array_changed(array, 0);
+    StatusCode status = OK;
+
+    if (has_suffix(filename, ".i32")) {
+        status = load_binary(array, fd, size);
+    } else if (size > 0) {
+        char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return ERROR_FILE_READ;
+        }
+        posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+        status = load_text(array, data, size);
+        munmap(data, size);
+    }
+
+    close(fd);
+    return status;
+}
+
+// Пишет "%d " в буфер; возвращает число записанных символов
+static size_t format_int(char *out, int value) {
+    char digits[12];
+    size_t count = 0;
+    size_t length = 0;
+    unsigned magnitude = value < 0 ? 0u - (unsigned) value : (unsigned) value;
+
+    do {
+        digits[count++] = (char) ('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+
+    if (value < 0) out[length++] = '-';
+    while (count) out[length++] = digits[--count];
+    out[length++] = ' ';
+    return length;
+}
+
 StatusCode cmd_save(const Array *array, const char *filename) {
-    FILE *file = fopen(filename, "w");
+    FILE *file = fopen(filename, "wb");
     if (!file) return ERROR_FILE_OPEN;
 
-    for (int i = 0; i < array->size; i++) {
-        if (fprintf(file, "%d ", array->data[i]) < 0) {
-            fclose(file);
-            return ERROR_FILE_WRITE;
+    int ok = 1;
+    if (has_suffix(filename, ".i32")) {
+        ok = fwrite(array->data, sizeof(int32_t), (size_t) array->size, file) == (size_t) array->size;
+    } else {
+        char buffer[SAVE_BUFFER_SIZE];
+        size_t used = 0;
+        for (int i = 0; i < array->size && ok; i++) {
+            if (used > SAVE_BUFFER_SIZE - 16) {
+                ok = fwrite(buffer, 1, used, file) == used;
+                used = 0;
+            }
+            used += format_int(buffer + used, array->data[i]);
         }
+        ok = ok && fwrite(buffer, 1, used, file) == used;
     }
 
-    fclose(file);
-    return OK;
+    if (fclose(file) != 0) ok = 0;
+    return ok ? OK : ERROR_FILE_WRITE;
+}
+
+static inline uint64_t rotl64(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += UINT64_C(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
+static void rng_seed(Rng *rng, uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        rng->s[i] = splitmix64(&seed);
+    }
+}
+
+static uint64_t rng_next(Rng *rng) {
+    uint64_t *s = rng->s;
+    uint64_t result = rotl64(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl64(s[3], 45);
+    return result;
+}
+
+// У каждого массива свой поток чисел: rand A и rand B не зависят друг от друга
+// и дают одно и то же при одном сиде независимо от порядка исполнения
+void seed_storage(ArrayStorage *storage, uint64_t seed) {
+    for (int i = 0; i < MAX_ARRAYS; i++) {
+        rng_seed(&storage->rngs[i], seed);
+        seed = splitmix64(&seed);
+    }
+}
+
+// Равномерное число в [0, range) без смещения (Лемир): умножение вместо деления,
+// остаток от деления считается только в редком случае возможного отказа
+static uint32_t rng_bounded(Rng *rng, uint32_t range) {
+    uint64_t m = (rng_next(rng) >> 32) * range;
+    uint32_t low = (uint32_t) m;
+    if (low < range) {
+        uint32_t threshold = (uint32_t) -range % range;
+        while (low < threshold) {
+            m = (rng_next(rng) >> 32) * range;
+            low = (uint32_t) m;
+        }
+    }
+    return (uint32_t) (m >> 32);
+}
+
+// Четыре независимых генератора, разложенные по словам: цикл по дорожкам
+// компилятор превращает в векторные операции
+typedef struct {
+    uint64_t s[4][RNG_LANES];
+} RngLanes;
+
+static void rng_lanes_seed(RngLanes *lanes, Rng *rng) {
+    for (int lane = 0; lane < RNG_LANES; lane++) {
+        uint64_t seed = rng_next(rng);
+        for (int i = 0; i < 4; i++) {
+            lanes->s[i][lane] = splitmix64(&seed);
+        }
+    }
 }
 
-StatusCode cmd_rand(Array *array, int count, int lb, int rb) {
+static void rng_lanes_next(RngLanes *lanes, uint64_t *out) {
+    for (int lane = 0; lane < RNG_LANES; lane++) {
+        uint64_t s1 = lanes->s[1][lane];
+        out[lane] = rotl64(s1 * 5, 7) * 9;
+        uint64_t t = s1 << 17;
+        lanes->s[2][lane] ^= lanes->s[0][lane];
+        lanes->s[3][lane] ^= s1;
+        lanes->s[1][lane] ^= lanes->s[2][lane];
+        lanes->s[0][lane] ^= lanes->s[3][lane];
+        lanes->s[2][lane] ^= t;
+        lanes->s[3][lane] = rotl64(lanes->s[3][lane], 45);
+    }
+}
+
+// Заполняет data числами из [lb, rb]: каждое 64-битное слово даёт две 32-битные выборки,
+// диапазон до 2^32 значений сводится умножением, редкие отказы просто пропускаются
+static void fill_uniform(int *data, size_t n, int lb, int rb, Rng *rng) {
+    uint64_t range = (uint64_t) ((int64_t) rb - lb) + 1;
+    uint64_t threshold = (((uint64_t) 1 << 32) - range) % range;
+    RngLanes lanes;
+    uint64_t block[RNG_LANES];
+    size_t filled = 0;
+
+    rng_lanes_seed(&lanes, rng);
+    while (filled < n) {
+        rng_lanes_next(&lanes, block);
+        for (int lane = 0; lane < RNG_LANES * 2 && filled < n; lane++) {
+            uint64_t sample = lane & 1 ? block[lane / 2] >> 32 : block[lane / 2] & UINT32_MAX;
+            uint64_t m = sample * range;
+            if ((m & UINT32_MAX) < threshold) continue;
+            data[filled++] = (int) ((int64_t) lb + (int64_t) (m >> 32));
+        }
+    }
+}
+
+StatusCode cmd_rand(Array *array, Rng *rng, int count, int lb, int rb) {
     if (count < 0 || lb > rb) return ERROR_INVALID_PARAMS;
 
     StatusCode status = ensure_capacity(array, count);
     if (status != OK) return status;
 
     array->size = count;
-    for (int i = 0; i < count; i++) {
-        array->data[i] = lb + rand() % (rb - lb + 1);
-    }
+    fill_uniform(array->data, (size_t) count, lb, rb, rng);
+    array_changed(array, 0);
 
     return OK;
 }
 
 int compare_asc(const void *a, const void *b) {
-    return (*(int *) a - *(int *) b);
+    int x = *(const int *) a;
+    int y = *(const int *) b;
+    return (x > y) - (x < y);
 }
 
 int compare_desc(const void *a, const void *b) {
-    return (*(int *) b - *(int *) a);
+    return compare_asc(b, a);
+}
+
+// Ключ со сдвинутым знаковым битом сравнивается как беззнаковое число в том же порядке, что int
+static uint32_t radix_key(int value) {
+    return (uint32_t) value ^ UINT32_C(0x80000000);
+}
+
+// LSD по байтам: одна гистограмма на все четыре прохода, проходы с одинаковым байтом у всех пропускаются.
+// Результат всегда остаётся в data
+void radix_sort(int *data, int *scratch, size_t n) {
+    size_t counts[4][256] = {{0}};
+    for (size_t i = 0; i < n; i++) {
+        uint32_t key = radix_key(data[i]);
+        counts[0][key & 0xFF]++;
+        counts[1][(key >> 8) & 0xFF]++;
+        counts[2][(key >> 16) & 0xFF]++;
+        counts[3][key >> 24]++;
+    }
+
+    int *src = data;
+    int *dst = scratch;
+    for (unsigned pass = 0; pass < 4; pass++) {
+        unsigned shift = pass * 8;
+        if (counts[pass][(radix_key(src[0]) >> shift) & 0xFF] == n) continue;
+
+        size_t offsets[256];
+        size_t sum = 0;
+        for (size_t digit = 0; digit < 256; digit++) {
+            offsets[digit] = sum;
+            sum += counts[pass][digit];
+        }
+        for (size_t i = 0; i < n; i++) {
+            dst[offsets[(radix_key(src[i]) >> shift) & 0xFF]++] = src[i];
+        }
+
+        int *temp = src;
+        src = dst;
+        dst = temp;
+    }
+
+    if (src != data) {
+        memcpy(data, src, n * sizeof(int));
+    }
+}
+
+static size_t sort_thread_count(void) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    if (online < 1) return 1;
+    return online > MAX_SORT_THREADS ? MAX_SORT_THREADS : (size_t) online;
+}
+
+static size_t bucket_of(int value, const int *splitters, size_t splitter_count) {
+    size_t low = 0;
+    size_t high = splitter_count;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (splitters[mid] <= value) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// Шаг сэмпл-сорта для одного потока: сначала посчитать свой кусок по корзинам,
+// затем разложить его в temp, затем отсортировать свою корзину
+typedef struct {
+    int *data;
+    int *temp;
+    size_t begin;
+    size_t end;
+    const int *splitters;
+    size_t splitter_count;
+    size_t *counts;
+    size_t *offsets;
+    size_t bucket_begin;
+    size_t bucket_end;
+    int phase;
+} SortTask;
+
+static void *sort_worker(void *arg) {
+    SortTask *task = arg;
+
+    if (task->phase == 0) {
+        for (size_t i = task->begin; i < task->end; i++) {
+            task->counts[bucket_of(task->data[i], task->splitters, task->splitter_count)]++;
+        }
+    } else if (task->phase == 1) {
+        for (size_t i = task->begin; i < task->end; i++) {
+            size_t bucket = bucket_of(task->data[i], task->splitters, task->splitter_count);
+            task->temp[task->offsets[bucket]++] = task->data[i];
+        }
+    } else {
+        size_t length = task->bucket_end - task->bucket_begin;
+        memcpy(task->data + task->bucket_begin, task->temp + task->bucket_begin, length * sizeof(int));
+        if (length > 0) {
+            radix_sort(task->data + task->bucket_begin, task->temp + task->bucket_begin, length);
+        }
+    }
+    return NULL;
+}
+
+static void run_sort_phase(SortTask *tasks, size_t count, int phase) {
+    pthread_t threads[MAX_SORT_THREADS];
+    int started[MAX_SORT_THREADS] = {0};
+
+    for (size_t i = 0; i < count; i++) {
+        tasks[i].phase = phase;
+    }
+    for (size_t i = 1; i < count; i++) {
+        started[i] = pthread_create(&threads[i], NULL, sort_worker, &tasks[i]) == 0;
+        if (!started[i]) sort_worker(&tasks[i]);
+    }
+    sort_worker(&tasks[0]);
+    for (size_t i = 1; i < count; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+    }
+}
+
+// Сэмпл-сорт: разделители из равномерной выборки делят массив на корзины по одной на поток,
+// каждая корзина сортируется поразрядно в своём потоке
+StatusCode parallel_sample_sort(int *data, size_t n, size_t threads) {
+    size_t sample_size = threads * SAMPLE_OVERSAMPLING;
+    int *temp = malloc(n * sizeof(int));
+    int *sample = malloc(sample_size * sizeof(int));
+    size_t *counts = calloc(threads * threads, sizeof(size_t));
+    if (!temp || !sample || !counts) {
+        free(temp);
+        free(sample);
+        free(counts);
+        return ERROR_MEMORY;
+    }
+
+    for (size_t i = 0; i < sample_size; i++) {
+        sample[i] = data[i * (n / sample_size)];
+    }
+    qsort(sample, sample_size, sizeof(int), compare_asc);
+
+    int splitters[MAX_SORT_THREADS];
+    for (size_t i = 0; i + 1 < threads; i++) {
+        splitters[i] = sample[(i + 1) * SAMPLE_OVERSAMPLING];
+    }
+
+    SortTask tasks[MAX_SORT_THREADS];
+    for (size_t i = 0; i < threads; i++) {
+        tasks[i] = (SortTask) {data, temp, n / threads * i, i + 1 == threads ? n : n / threads * (i + 1),
+                               splitters, threads - 1, counts + i * threads, counts + i * threads, 0, 0, 0};
+    }
+    run_sort_phase(tasks, threads, 0);
+
+    // counts[i][b] превращаем в смещения куска i внутри корзины b
+    size_t position = 0;
+    for (size_t bucket = 0; bucket < threads; bucket++) {
+        tasks[bucket].bucket_begin = position;
+        for (size_t i = 0; i < threads; i++) {
+            size_t count = counts[i * threads + bucket];
+            counts[i * threads + bucket] = position;
+            position += count;
+        }
+        tasks[bucket].bucket_end = position;
+    }
+    run_sort_phase(tasks, threads, 1);
+    run_sort_phase(tasks, threads, 2);
+
+    free(temp);
+    free(sample);
+    free(counts);
+    return OK;
+}
+
+static void reverse_ints(int *data, size_t n) {
+    for (size_t i = 0, j = n - 1; i < j; i++, j--) {
+        int temp = data[i];
+        data[i] = data[j];
+        data[j] = temp;
+    }
+}
+
+// Алгоритм выбирается по размеру: qsort для коротких, поразрядная для средних, сэмпл-сорт для больших
+StatusCode sort_ints(int *data, size_t n, int ascending) {
+    if (n < RADIX_SORT_THRESHOLD) {
+        qsort(data, n, sizeof(int), ascending ? compare_asc : compare_desc);
+        return OK;
+    }
+
+    size_t threads = sort_thread_count();
+    StatusCode status = ERROR_MEMORY;
+    if (threads > 1 && n >= PARALLEL_SORT_THRESHOLD) {
+        status = parallel_sample_sort(data, n, threads);
+    }
+    if (status != OK) {
+        int *scratch = malloc(n * sizeof(int));
+        if (!scratch) {
+            qsort(data, n, sizeof(int), ascending ? compare_asc : compare_desc);
+            return OK;
+        }
+        radix_sort(data, scratch, n);
+        free(scratch);
+    }
+
+    if (!ascending) {
+        reverse_ints(data, n);
+    }
+    return OK;
+}
+
+// Первый индекс, с которого a[i] >= value (по возрастанию) или a[i] <= value (по убыванию)
+static int first_position(const int *data, int n, int value, int ascending) {
+    int low = 0;
+    int high = n;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (ascending ? data[mid] < value : data[mid] > value) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
 }
 
 StatusCode cmd_sort(Array *array, int ascending) {
     if (array->size == 0) return OK;
-    qsort(array->data, array->size, sizeof(int), ascending ? compare_asc : compare_desc);
+    StatusCode status = make_writable(array);
+    if (status != OK) return status;
+    status = sort_ints(array->data, (size_t) array->size, ascending);
+    if (status != OK) return status;
+
+    // Значения те же, меняются только позиции крайних — в отсортированном массиве их находит бинпоиск
+    array_changed(array, STATS_SUM | STATS_MINMAX | STATS_MODE);
+    if (array->stats_valid & STATS_MINMAX) {
+        array->stats.min_idx = first_position(array->data, array->size, array->stats.min, ascending);
+        array->stats.max_idx = first_position(array->data, array->size, array->stats.max, ascending);
+        array->stats_valid |= STATS_INDICES;
+    }
     return OK;
 }
 
-StatusCode cmd_shuffle(Array *array) {
-    for (int i = array->size - 1; i > 0; i--) {
-        int j = rand() % (i + 1);
-        int temp = array->data[i];
-        array->data[i] = array->data[j];
-        array->data[j] = temp;
+static void swap_ints(int *data, size_t i, size_t j) {
+    int temp = data[i];
+    data[i] = data[j];
+    data[j] = temp;
+}
+
+static void fisher_yates(int *data, size_t n, Rng *rng) {
+    for (size_t i = n - 1; i > 0; i--) {
+        swap_ints(data, i, rng_bounded(rng, (uint32_t) (i + 1)));
+    }
+}
+
+// Слияние двух перемешанных половин (MergeShuffle): по монетке берём следующий элемент
+// из левой или правой половины, а когда одна кончилась, остаток вставляем на случайные места
+static void merge_shuffled(int *data, size_t mid, size_t n, Rng *rng) {
+    size_t i = 0;
+    size_t j = mid;
+    uint64_t bits = 0;
+    int bits_left = 0;
+
+    while (1) {
+        if (bits_left == 0) {
+            bits = rng_next(rng);
+            bits_left = 64;
+        }
+        int take_right = (int) (bits & 1);
+        bits >>= 1;
+        bits_left--;
+        if (take_right) {
+            if (j == n) break;
+            swap_ints(data, i, j++);
+        } else if (i == j) {
+            break;
+        }
+        i++;
+    }
+    for (; i < n; i++) {
+        swap_ints(data, i, rng_bounded(rng, (uint32_t) (i + 1)));
+    }
+}
+
+// Кусок для параллельного перемешивания: перемешать целиком или слить две уже перемешанные половины
+typedef struct {
+    int *data;
+    size_t begin;
+    size_t mid;
+    size_t end;
+    int merge;
+    Rng rng;
+} ShuffleTask;
+
+typedef struct {
+    ShuffleTask *tasks;
+    size_t count;
+    size_t first;
+    size_t step;
+} ShuffleWorker;
+
+static void *shuffle_worker(void *arg) {
+    ShuffleWorker *worker = arg;
+    for (size_t t = worker->first; t < worker->count; t += worker->step) {
+        ShuffleTask *task = &worker->tasks[t];
+        size_t length = task->end - task->begin;
+        if (task->merge) {
+            merge_shuffled(task->data + task->begin, task->mid - task->begin, length, &task->rng);
+        } else if (length > 1) {
+            fisher_yates(task->data + task->begin, length, &task->rng);
+        }
+    }
+    return NULL;
+}
+
+static void run_shuffle_tasks(ShuffleTask *tasks, size_t count, size_t threads) {
+    pthread_t handles[SHUFFLE_CHUNKS];
+    ShuffleWorker workers[SHUFFLE_CHUNKS];
+    int started[SHUFFLE_CHUNKS] = {0};
+
+    if (threads > count) threads = count;
+    for (size_t i = 0; i < threads; i++) {
+        workers[i] = (ShuffleWorker) {tasks, count, i, threads};
+    }
+    for (size_t i = 1; i < threads; i++) {
+        started[i] = pthread_create(&handles[i], NULL, shuffle_worker, &workers[i]) == 0;
+        if (!started[i]) shuffle_worker(&workers[i]);
     }
+    shuffle_worker(&workers[0]);
+    for (size_t i = 1; i < threads; i++) {
+        if (started[i]) pthread_join(handles[i], NULL);
+    }
+}
+
+// Число кусков не зависит от числа ядер, поэтому результат при одном сиде одинаков на любой машине
+static void parallel_merge_shuffle(int *data, size_t n, Rng *rng, size_t threads) {
+    ShuffleTask tasks[SHUFFLE_CHUNKS];
+    size_t bounds[SHUFFLE_CHUNKS + 1];
+
+    for (size_t c = 0; c <= SHUFFLE_CHUNKS; c++) {
+        bounds[c] = n * c / SHUFFLE_CHUNKS;
+    }
+    for (size_t c = 0; c < SHUFFLE_CHUNKS; c++) {
+        tasks[c] = (ShuffleTask) {data, bounds[c], bounds[c], bounds[c + 1], 0, {{0}}};
+        rng_seed(&tasks[c].rng, rng_next(rng));
+    }
+    run_shuffle_tasks(tasks, SHUFFLE_CHUNKS, threads);
+
+    for (size_t width = 1; width < SHUFFLE_CHUNKS; width *= 2) {
+        size_t count = 0;
+        for (size_t c = 0; c + width < SHUFFLE_CHUNKS; c += 2 * width) {
+            size_t end = c + 2 * width < SHUFFLE_CHUNKS ? c + 2 * width : SHUFFLE_CHUNKS;
+            tasks[count] = (ShuffleTask) {data, bounds[c], bounds[c + width], bounds[end], 1, {{0}}};
+            rng_seed(&tasks[count].rng, rng_next(rng));
+            count++;
+        }
+        run_shuffle_tasks(tasks, count, threads);
+    }
+}
+
+StatusCode cmd_shuffle(Array *array, Rng *rng) {
+    if (array->size < 2) return OK;
+    StatusCode status = make_writable(array);
+    if (status != OK) return status;
+
+    // Алгоритм выбирается только по n: иначе один сид давал бы разные перестановки
+    // на машинах с разным числом ядер. На одном ядре те же куски идут последовательно
+    size_t n = (size_t) array->size;
+    if (n >= PARALLEL_SHUFFLE_THRESHOLD) {
+        parallel_merge_shuffle(array->data, n, rng, sort_thread_count());
+    } else {
+        fisher_yates(array->data, n, rng);
+    }
+    array_changed(array, STATS_SUM | STATS_MINMAX | STATS_MODE);
     return OK;
 }
 
-void find_min_max_mean(const Array *array, int *min, int *min_idx, int *max, int *max_idx, double *mean) {
-    *min = array->data[0];
-    *max = array->data[0];
-    *min_idx = 0;
-    *max_idx = 0;
+StatusCode cmd_concat(Array *array, const Array *second_array) {
+    int old_size = array->size;
+    ArrayStats second_stats = second_array->stats;
+    unsigned second_valid = second_array->stats_valid;
+    int second_size = second_array->size;
+
+    if (old_size == 0 && second_size > 0) {
+        share_slice(array, second_array, 0, second_size);
+        array->stats = second_stats;
+        array->stats_valid = second_valid;
+        array_changed(array, STATS_ALL);
+        return OK;
+    }
+
+    StatusCode status = ensure_capacity(array, array->size + second_size);
+    if (status != OK) return status;
 
-    double sum = array->data[0];
+    memcpy(array->data + array->size, second_array->data, (size_t) second_size * sizeof(int));
+    array->size += second_size;
 
-    for (int i = 1; i < array->size; i++) {
-        if (array->data[i] < *min) {
-            *min = array->data[i];
-            *min_idx = i;
+    if (second_size == 0) {
+        array_changed(array, STATS_ALL);
+        return OK;
+    }
+    // Сумма и крайние значения складываются из двух половин, частоты без полного подсчёта не слить
+    unsigned keep = array->stats_valid & second_valid & (STATS_SUM | STATS_MINMAX | STATS_INDICES);
+    ArrayStats *stats = &array->stats;
+    if (keep & STATS_SUM) {
+        stats->sum += second_stats.sum;
+    }
+    if (keep & STATS_MINMAX) {
+        if (second_stats.min < stats->min) {
+            stats->min = second_stats.min;
+            stats->min_idx = old_size + second_stats.min_idx;
         }
-        if (array->data[i] > *max) {
-            *max = array->data[i];
-            *max_idx = i;
+        if (second_stats.max > stats->max) {
+            stats->max = second_stats.max;
+            stats->max_idx = old_size + second_stats.max_idx;
         }
-        sum += array->data[i];
     }
-    *mean = sum / array->size;
+    array_changed(array, keep);
+    return OK;
 }
 
+StatusCode cmd_remove(Array *array, int start, int count) {
+    if (start < 0 || start >= array->size || count < 0 || start + count > array->size) {
+        return ERROR_INVALID_INDEX;
+    }
+    if (count == 0) return OK;
+
+    ArrayStats *stats = &array->stats;
+    unsigned keep = array->stats_valid & (STATS_SUM | STATS_MINMAX | STATS_INDICES);
+    if (keep & STATS_SUM) {
+        for (int i = start; i < start + count; i++) {
+            stats->sum -= array->data[i];
+        }
+    }
+    // Крайнее значение остаётся прежним, если его первое вхождение не попало под удаление
+    if ((keep & STATS_INDICES) && (keep & STATS_MINMAX)) {
+        int min_removed = stats->min_idx >= start && stats->min_idx < start + count;
+        int max_removed = stats->max_idx >= start && stats->max_idx < start + count;
+        if (min_removed || max_removed) {
+            keep &= ~(STATS_MINMAX | STATS_INDICES);
+        } else {
+            stats->min_idx -= stats->min_idx >= start + count ? count : 0;
+            stats->max_idx -= stats->max_idx >= start + count ? count : 0;
+        }
+    } else {
+        keep &= ~(STATS_MINMAX | STATS_INDICES);
+    }
 
-void find_deviation(const Array *array, double *max_deviation, const double mean) {
-    *max_deviation = 0;
-    for (int i = 0; i < array->size; i++) {
-        double deviation = fabs(array->data[i] - mean);
-        if (deviation > *max_deviation) {
-            *max_deviation = deviation;
+    // Срез с головы или хвоста — просто сдвиг границ, даже у общего буфера.
+    // Из середины двигаем меньшую из двух частей
+    int tail = array->size - start - count;
+    if (start == 0) {
+        attach_buffer(array, array->buffer, array->offset + count);
+    } else if (tail > 0 && atomic_load(&array->buffer->refcount) > 1) {
+        // Общий буфер всё равно копировать — сразу собираем новый без удалённого куска
+        int remaining = array->size - count;
+        IntBuffer *buffer = alloc_buffer(remaining < INITIAL_ARRAY_CAPACITY ? INITIAL_ARRAY_CAPACITY : remaining);
+        if (!buffer) return ERROR_MEMORY;
+
+        memcpy(buffer->data, array->data, (size_t) start * sizeof(int));
+        memcpy(buffer->data + start, array->data + start + count, (size_t) tail * sizeof(int));
+        release_buffer(array->buffer);
+        attach_buffer(array, buffer, 0);
+    } else if (tail > 0) {
+        if (start < tail) {
+            memmove(array->data + count, array->data, (size_t) start * sizeof(int));
+            attach_buffer(array, array->buffer, array->offset + count);
+        } else {
+            memmove(array->data + start, array->data + start + count, (size_t) tail * sizeof(int));
         }
     }
+    array->size -= count;
+    array_changed(array, keep);
+    return OK;
 }
 
-void find_most_frequent(const Array *array, int *most_freq, int *frequency) {
-    if (array->size == 0) {
-        *most_freq = 0;
-        *frequency = 0;
-        return;
+// Приёмник становится срезом источника; данные скопируются, только когда в один из них запишут
+StatusCode cmd_copy(const Array *array, int start, int end, Array *dest_array) {
+    int count = end - start + 1;
+    int whole_array = count == array->size;
+
+    share_slice(dest_array, array, start, count);
+
+    // Копия целого массива получает его статистику как есть
+    if (whole_array && dest_array != array) {
+        dest_array->stats = array->stats;
+        dest_array->stats_valid = array->stats_valid;
     }
+    array_changed(dest_array, whole_array ? STATS_ALL : 0);
+    return OK;
+}
 
-    Array temp_array = *array;
-    temp_array.data = malloc(array->size * sizeof(int)); // Выделяем память под копию
-    if (!temp_array.data) {
-        *most_freq = 0;
-        *frequency = 0;
-        return;
+// Ключи и счётчики — отдельные массивы по 4 байта, пустой слот — нулевой счётчик
+typedef struct {
+    int *keys;
+    uint32_t *counts;
+    size_t capacity;
+    size_t used;
+} FrequencyTable;
+
+// Без индексов цикл ветвлений не содержит и векторизуется компилятором
+static void find_extremes_and_sum(const int *data, size_t n, ArrayStats *stats) {
+    int min = data[0];
+    int max = data[0];
+    int64_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        int value = data[i];
+        min = value < min ? value : min;
+        max = value > max ? value : max;
+        sum += value;
     }
-    memcpy(temp_array.data, array->data, array->size * sizeof(int)); // Копируем содержимое
+    stats->min = min;
+    stats->max = max;
+    stats->sum = sum;
+}
 
-    qsort(temp_array.data, temp_array.size, sizeof(int), compare_asc);
+// При равной частоте выбирается больший элемент, как и раньше
+static void take_if_more_frequent(ArrayStats *stats, int value, uint32_t count) {
+    if ((int) count > stats->frequency || ((int) count == stats->frequency && value > stats->most_freq)) {
+        stats->most_freq = value;
+        stats->frequency = (int) count;
+    }
+}
 
-    int current_freq = 1;
-    int max_freq = 1;
-    int current_element = temp_array.data[0];
-    *most_freq = temp_array.data[0];
+static size_t frequency_slot(int key, size_t mask) {
+    return (size_t) (((uint32_t) key * UINT32_C(0x9E3779B1)) ^ ((uint32_t) key >> 16)) & mask;
+}
 
-    for (int i = 1; i < temp_array.size; i++) {
-        if (temp_array.data[i] == current_element) {
-            current_freq++;
-        } else {
-            if (current_freq > max_freq ||
-                (current_freq == max_freq && current_element > *most_freq)) {
-                max_freq = current_freq;
-                *most_freq = current_element;
-            }
-            current_freq = 1;
-            current_element = temp_array.data[i];
+static int frequency_table_init(FrequencyTable *table, size_t capacity) {
+    table->keys = malloc(capacity * sizeof(int));
+    table->counts = calloc(capacity, sizeof(uint32_t));
+    table->capacity = capacity;
+    table->used = 0;
+    if (!table->keys || !table->counts) {
+        free(table->keys);
+        free(table->counts);
+        return 0;
+    }
+    return 1;
+}
+
+static void free_frequency_table(FrequencyTable *table) {
+    free(table->keys);
+    free(table->counts);
+}
+
+static uint32_t *frequency_counter(FrequencyTable *table, int key) {
+    size_t mask = table->capacity - 1;
+    size_t slot = frequency_slot(key, mask);
+    while (table->counts[slot] && table->keys[slot] != key) {
+        slot = (slot + 1) & mask;
+    }
+    if (!table->counts[slot]) {
+        table->keys[slot] = key;
+        table->used++;
+    }
+    return &table->counts[slot];
+}
+
+// Вместе со старой таблицей на время переноса занимает не больше limit слотов по 8 байт
+static int grow_frequency_table(FrequencyTable *table, size_t limit) {
+    FrequencyTable bigger;
+    if (table->capacity * 3 > limit || !frequency_table_init(&bigger, table->capacity * 2)) return 0;
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (table->counts[i]) *frequency_counter(&bigger, table->keys[i]) = table->counts[i];
+    }
+    free_frequency_table(table);
+    *table = bigger;
+    return 1;
+}
+
+// Хеш-таблица растёт с числом различных значений (заполнение не выше ~77%) и не больше 4 байт
+// на элемент. Если значений больше, частоты считаются по отсортированной копии, как раньше
+static StatusCode count_with_table(const int *data, size_t n, ArrayStats *stats) {
+    FrequencyTable table;
+    size_t limit = n / 2;
+    int fits = frequency_table_init(&table, 16);
+    if (!fits) return ERROR_MEMORY;
+
+    for (size_t i = 0; i < n && fits; i++) {
+        (*frequency_counter(&table, data[i]))++;
+        if (table.used * 13 > table.capacity * 10) fits = grow_frequency_table(&table, limit);
+    }
+    if (fits) {
+        for (size_t i = 0; i < table.capacity; i++) {
+            if (table.counts[i]) take_if_more_frequent(stats, table.keys[i], table.counts[i]);
         }
     }
+    free_frequency_table(&table);
+    if (fits) return OK;
+
+    int *sorted = malloc(n * sizeof(int));
+    if (!sorted) return ERROR_MEMORY;
+    memcpy(sorted, data, n * sizeof(int));
+    qsort(sorted, n, sizeof(int), compare_asc);
+    for (size_t start = 0, end; start < n; start = end) {
+        for (end = start + 1; end < n && sorted[end] == sorted[start]; end++) {}
+        take_if_more_frequent(stats, sorted[start], (uint32_t) (end - start));
+    }
+    free(sorted);
+    return OK;
+}
+
+// Второй проход: частоты (счётным массивом при малом размахе, иначе хеш-таблицей) и первые индексы min/max
+static StatusCode count_frequencies(const int *data, size_t n, ArrayStats *stats) {
+    uint64_t range = (uint64_t) ((int64_t) stats->max - stats->min) + 1;
+    int min_idx = -1;
+    int max_idx = -1;
 
-    if (current_freq > max_freq ||
-        (current_freq == max_freq && current_element > *most_freq)) {
-        max_freq = current_freq;
-        *most_freq = current_element;
+    stats->most_freq = data[0];
+    stats->frequency = 0;
+
+    if (range <= COUNTING_RANGE_LIMIT && range <= (uint64_t) n * 4 + COUNTING_RANGE_MIN) {
+        uint32_t *counts = calloc((size_t) range, sizeof(uint32_t));
+        if (!counts) return ERROR_MEMORY;
+
+        for (size_t i = 0; i < n; i++) {
+            int value = data[i];
+            counts[(uint32_t) ((int64_t) value - stats->min)]++;
+            if (min_idx < 0 && value == stats->min) min_idx = (int) i;
+            if (max_idx < 0 && value == stats->max) max_idx = (int) i;
+        }
+        for (size_t i = 0; i < range; i++) {
+            if (counts[i]) take_if_more_frequent(stats, (int) ((int64_t) stats->min + (int64_t) i), counts[i]);
+        }
+        free(counts);
+    } else {
+        StatusCode status = count_with_table(data, n, stats);
+        if (status != OK) return status;
+        for (size_t i = 0; i < n && (min_idx < 0 || max_idx < 0); i++) {
+            if (min_idx < 0 && data[i] == stats->min) min_idx = (int) i;
+            if (max_idx < 0 && data[i] == stats->max) max_idx = (int) i;
+        }
     }
 
-    *frequency = max_freq;
-    free(temp_array.data);
+    stats->min_idx = min_idx;
+    stats->max_idx = max_idx;
+    return OK;
 }
 
+static void find_first_indices(const int *data, size_t n, ArrayStats *stats) {
+    stats->min_idx = -1;
+    stats->max_idx = -1;
+    for (size_t i = 0; i < n && (stats->min_idx < 0 || stats->max_idx < 0); i++) {
+        if (stats->min_idx < 0 && data[i] == stats->min) stats->min_idx = (int) i;
+        if (stats->max_idx < 0 && data[i] == stats->max) stats->max_idx = (int) i;
+    }
+}
+
+// Досчитывает только недостающие части; если массив не менялся, это O(1)
+StatusCode compute_stats(Array *array) {
+    size_t n = (size_t) array->size;
+    ArrayStats *stats = &array->stats;
+
+    if ((array->stats_valid & (STATS_SUM | STATS_MINMAX)) != (STATS_SUM | STATS_MINMAX)) {
+        find_extremes_and_sum(array->data, n, stats);
+        array->stats_valid = (array->stats_valid & STATS_MODE) | STATS_SUM | STATS_MINMAX;
+    }
+    if (!(array->stats_valid & STATS_MODE)) {
+        StatusCode status = count_frequencies(array->data, n, stats);
+        if (status != OK) return status;
+        array->stats_valid |= STATS_MODE | STATS_INDICES;
+    } else if (!(array->stats_valid & STATS_INDICES)) {
+        find_first_indices(array->data, n, stats);
+        array->stats_valid |= STATS_INDICES;
+    }
+    return OK;
+}
 
-StatusCode cmd_stats(const Array *array) {
+StatusCode cmd_stats(Array *array, FILE *out) {
     if (array->size == 0) {
-        printf("Array is empty\n");
+        fprintf(out, "Array is empty\n");
         return OK;
     }
 
-    int min, max, min_idx, max_idx, most_freq, frequency;
-    double mean, max_deviation;
+    StatusCode status = compute_stats(array);
+    if (status != OK) return status;
+    ArrayStats stats = array->stats;
 
-    find_min_max_mean(array, &min, &min_idx, &max, &max_idx, &mean);
-    find_deviation(array, &max_deviation, mean);
-    find_most_frequent(array, &most_freq, &frequency);
+    // Наибольшее отклонение от среднего всегда достигается на минимуме или максимуме
+    double mean = (double) stats.sum / array->size;
+    double below = mean - stats.min;
+    double above = stats.max - mean;
+    double max_deviation = below > above ? below : above;
 
-    printf("Size: %d\n", array->size);
-    printf("Min: %d (index: %d)\n", min, min_idx);
-    printf("Max: %d (index: %d)\n", max, max_idx);
-    printf("Most frequent: %d (frequency: %d)\n", most_freq, frequency);
-    printf("Mean: %.2f\n", mean);
-    printf("Max deviation: %.2f\n", max_deviation);
+    fprintf(out, "Size: %d\n", array->size);
+    fprintf(out, "Min: %d (index: %d)\n", stats.min, stats.min_idx);
+    fprintf(out, "Max: %d (index: %d)\n", stats.max, stats.max_idx);
+    fprintf(out, "Most frequent: %d (frequency: %d)\n", stats.most_freq, stats.frequency);
+    fprintf(out, "Mean: %.2f\n", mean);
+    fprintf(out, "Max deviation: %.2f\n", max_deviation);
 
     return OK;
 }
 
-StatusCode cmd_print(const Array *array, int start, int end) {
+StatusCode cmd_print(const Array *array, int start, int end, FILE *out) {
     if (start < 0 || start >= array->size || end < start || end >= array->size) {
         return ERROR_INVALID_INDEX;
     }
 
     for (int i = start; i <= end; i++) {
-        printf("%d ", array->data[i]);
+        fprintf(out, "%d ", array->data[i]);
+    }
+    fprintf(out, "\n");
+    return OK;
+}
+
+// Команда, разобранная один раз: массив, второй массив и до трёх целых операндов.
+// Имена файлов лежат в пуле строк программы, в a хранится смещение
+typedef enum {
+    OP_LOAD,
+    OP_SAVE,
+    OP_RAND,
+    OP_CONCAT,
+    OP_FREE,
+    OP_REMOVE,
+    OP_COPY,
+    OP_SORT,
+    OP_SHUFFLE,
+    OP_STATS,
+    OP_PRINT_ALL,
+    OP_PRINT_RANGE,
+    OP_PRINT_INDEX,
+    OP_ERROR,
+    OP_EXIT
+} Opcode;
+
+typedef struct {
+    uint8_t opcode;
+    uint8_t array;
+    uint8_t target;
+    uint8_t status;
+    int32_t a;
+    int32_t b;
+    int32_t c;
+} Instruction;
+
+typedef struct {
+    Instruction *code;
+    size_t count;
+    size_t capacity;
+    char *pool;
+    size_t pool_size;
+    size_t pool_capacity;
+} Program;
+
+// Заголовок файла с байткодом, за ним инструкции и пул строк
+typedef struct {
+    char magic[4];
+    uint32_t instruction_size;
+    uint64_t key;
+    uint64_t script_size;
+    uint64_t count;
+    uint64_t pool_size;
+} BytecodeHeader;
+
+void free_program(Program *program) {
+    free(program->code);
+    free(program->pool);
+    program->code = NULL;
+    program->pool = NULL;
+    program->count = program->capacity = 0;
+    program->pool_size = program->pool_capacity = 0;
+}
+
+StatusCode emit_instruction(Program *program, Instruction instruction) {
+    if (program->count == program->capacity) {
+        size_t new_capacity = program->capacity ? program->capacity * 2 : 64;
+        Instruction *new_code = realloc(program->code, new_capacity * sizeof(Instruction));
+        if (!new_code) return ERROR_MEMORY;
+        program->code = new_code;
+        program->capacity = new_capacity;
     }
-    printf("\n");
+    program->code[program->count++] = instruction;
     return OK;
 }
 
-StatusCode process_command(ArrayStorage *storage, char *command) {
+StatusCode emit_error(Program *program, StatusCode status) {
+    Instruction instruction = {OP_ERROR, 0, 0, (uint8_t) status, 0, 0, 0};
+    return emit_instruction(program, instruction);
+}
+
+StatusCode pool_string(Program *program, const char *str, int32_t *offset) {
+    size_t length = strlen(str) + 1;
+    if (program->pool_size + length > program->pool_capacity) {
+        size_t new_capacity = program->pool_capacity ? program->pool_capacity : 256;
+        while (program->pool_size + length > new_capacity) {
+            new_capacity *= 2;
+        }
+        char *new_pool = realloc(program->pool, new_capacity);
+        if (!new_pool) return ERROR_MEMORY;
+        program->pool = new_pool;
+        program->pool_capacity = new_capacity;
+    }
+    if (program->pool_size > INT32_MAX) return ERROR_MEMORY;
+
+    memcpy(program->pool + program->pool_size, str, length);
+    *offset = (int32_t) program->pool_size;
+    program->pool_size += length;
+    return OK;
+}
+
+// Разбирает строку так же, как раньше разбирал process_command, но только один раз.
+// Ошибки разбора становятся инструкцией OP_ERROR и выводятся при исполнении в своём месте
+StatusCode compile_command(Program *program, const char *command) {
     char cmd[MAX_COMMAND_LENGTH];
     char array_name;
 
-    if (sscanf(command, "%s %c", cmd, &array_name) != 2) {
-        return ERROR_INVALID_COMMAND;
+    if (strcmp(command, "exit") == 0) {
+        Instruction instruction = {OP_EXIT, 0, 0, OK, 0, 0, 0};
+        return emit_instruction(program, instruction);
     }
 
-    int array_idx = get_array_index(array_name);
-    if (array_idx < 0) return ERROR_INVALID_ARRAY_NAME;
+    if (sscanf(command, "%255s %c", cmd, &array_name) != 2) {
+        return emit_error(program, ERROR_INVALID_COMMAND);
+    }
 
-    Array *array = &storage->arrays[array_idx];
+    int array_idx = get_array_index(array_name);
+    if (array_idx < 0) return emit_error(program, ERROR_INVALID_ARRAY_NAME);
 
     for (char *p = cmd; *p; p++) {
-        *p = tolower(*p);
+        *p = (char) tolower((unsigned char) *p);
     }
 
-    if (strcmp(cmd, "load") == 0) {
+    Instruction instruction = {OP_ERROR, (uint8_t) array_idx, 0, OK, 0, 0, 0};
+
+    if (strcmp(cmd, "load") == 0 || strcmp(cmd, "save") == 0) {
         char filename[256];
         if (sscanf(command, "%*s %*c , %255s", filename) != 1) {
-            return ERROR_INVALID_PARAMS;
+            return emit_error(program, ERROR_INVALID_PARAMS);
+        }
+        StatusCode status = pool_string(program, filename, &instruction.a);
+        if (status != OK) return status;
+        instruction.opcode = cmd[0] == 'l' ? OP_LOAD : OP_SAVE;
+    } else if (strcmp(cmd, "rand") == 0) {
+        if (sscanf(command, "%*s %*c , %d , %d , %d", &instruction.a, &instruction.b, &instruction.c) != 3) {
+            return emit_error(program, ERROR_INVALID_PARAMS);
+        }
+        instruction.opcode = OP_RAND;
+    } else if (strcmp(cmd, "concat") == 0) {
+        char second_array_name;
+        if (sscanf(command, "%*s %*c , %c", &second_array_name) != 1) {
+            return emit_error(program, ERROR_INVALID_PARAMS);
         }
-        return cmd_load(array, filename);
-    }
 
-    if (strcmp(cmd, "save") == 0) {
-        char filename[256];
-        if (sscanf(command, "%*s %*c , %255s", filename) != 1) {
-            return ERROR_INVALID_PARAMS;
+        int second_idx = get_array_index(second_array_name);
+        if (second_idx < 0) return emit_error(program, ERROR_INVALID_ARRAY_NAME);
+
+        instruction.opcode = OP_CONCAT;
+        instruction.target = (uint8_t) second_idx;
+    } else if (strcmp(cmd, "free") == 0) {
+        instruction.opcode = OP_FREE;
+    } else if (strcmp(cmd, "remove") == 0) {
+        if (sscanf(command, "%*s %*c , %d , %d", &instruction.a, &instruction.b) != 2) {
+            return emit_error(program, ERROR_INVALID_PARAMS);
+        }
+        instruction.opcode = OP_REMOVE;
+    } else if (strcmp(cmd, "copy") == 0) {
+        char dest_array_name;
+        if (sscanf(command, "%*s %*c , %d , %d , %c", &instruction.a, &instruction.b, &dest_array_name) != 3) {
+            return emit_error(program, ERROR_INVALID_PARAMS);
         }
-        return cmd_save(array, filename);
-    }
 
-    if (strcmp(cmd, "rand") == 0) {
-        int count, lb, rb;
-        if (sscanf(command, "%*s %*c , %d , %d , %d", &count, &lb, &rb) != 3) {
-            return ERROR_INVALID_PARAMS;
+        // Индексы проверяются раньше имени приёмника, поэтому ошибку имени откладываем до исполнения
+        int dest_idx = get_array_index(dest_array_name);
+        instruction.opcode = OP_COPY;
+        instruction.target = (uint8_t) (dest_idx < 0 ? 0 : dest_idx);
+        instruction.status = (uint8_t) (dest_idx < 0 ? ERROR_INVALID_ARRAY_NAME : OK);
+    } else if (strcmp(cmd, "sort") == 0) {
+        char direction;
+        if (sscanf(command, "%*s %*c%c", &direction) != 1) {
+            return emit_error(program, ERROR_INVALID_PARAMS);
+        }
+        instruction.opcode = OP_SORT;
+        instruction.a = direction == '+';
+    } else if (strcmp(cmd, "shuffle") == 0) {
+        instruction.opcode = OP_SHUFFLE;
+    } else if (strcmp(cmd, "stats") == 0) {
+        instruction.opcode = OP_STATS;
+    } else if (strcmp(cmd, "print") == 0) {
+        char param[MAX_COMMAND_LENGTH];
+        if (sscanf(command, "%*s %*c , %255s", param) != 1) {
+            return emit_error(program, ERROR_INVALID_PARAMS);
+        }
+        if (strcmp(param, "all") == 0) {
+            instruction.opcode = OP_PRINT_ALL;
+        } else if (sscanf(command, "%*s %*c , %d , %d", &instruction.a, &instruction.b) == 2) {
+            instruction.opcode = OP_PRINT_RANGE;
+        } else if (sscanf(param, "%d", &instruction.a) == 1) {
+            instruction.opcode = OP_PRINT_INDEX;
+        } else {
+            return emit_error(program, ERROR_INVALID_PARAMS);
         }
-        return cmd_rand(array, count, lb, rb);
+    } else {
+        return emit_error(program, ERROR_INVALID_COMMAND);
     }
 
-    if (strcmp(cmd, "concat") == 0) {
-        char second_array_name;
-        if (sscanf(command, "%*s %*c , %c", &second_array_name) != 1) {
-            return ERROR_INVALID_PARAMS;
+    return emit_instruction(program, instruction);
+}
+
+StatusCode execute_instruction(ArrayStorage *storage, const Program *program, const Instruction *instruction,
+                               FILE *out) {
+    Array *array = &storage->arrays[instruction->array];
+
+    switch ((Opcode) instruction->opcode) {
+        case OP_LOAD:
+            return cmd_load(array, program->pool + instruction->a);
+
+        case OP_SAVE:
+            return cmd_save(array, program->pool + instruction->a);
+
+        case OP_RAND:
+            return cmd_rand(array, &storage->rngs[instruction->array], instruction->a, instruction->b, instruction->c);
+
+        case OP_CONCAT:
+            return cmd_concat(array, &storage->arrays[instruction->target]);
+
+        case OP_FREE:
+            free_array(array);
+            return init_array(array);
+
+        case OP_REMOVE:
+            return cmd_remove(array, instruction->a, instruction->b);
+
+        case OP_COPY: {
+            int start = instruction->a;
+            int end = instruction->b;
+            if (start < 0 || end >= array->size || start > end) {
+                return ERROR_INVALID_INDEX;
+            }
+            if (instruction->status != OK) return (StatusCode) instruction->status;
+            return cmd_copy(array, start, end, &storage->arrays[instruction->target]);
         }
 
-        int second_idx = get_array_index(second_array_name);
-        if (second_idx < 0) return ERROR_INVALID_ARRAY_NAME;
+        case OP_SORT:
+            return cmd_sort(array, instruction->a);
 
-        Array *second_array = &storage->arrays[second_idx];
+        case OP_SHUFFLE:
+            return cmd_shuffle(array, &storage->rngs[instruction->array]);
 
-        StatusCode status = ensure_capacity(array, array->size + second_array->size);
-        if (status != OK) return status;
+        case OP_STATS:
+            return cmd_stats(array, out);
 
-        memcpy(array->data + array->size, second_array->data, second_array->size * sizeof(int));
-        array->size += second_array->size;
+        case OP_PRINT_ALL:
+            return cmd_print(array, 0, array->size - 1, out);
 
-        return OK;
+        case OP_PRINT_RANGE:
+            return cmd_print(array, instruction->a, instruction->b, out);
+
+        case OP_PRINT_INDEX:
+            if (instruction->a < 0 || instruction->a >= array->size) {
+                return ERROR_INVALID_INDEX;
+            }
+            fprintf(out, "%d\n", array->data[instruction->a]);
+            return OK;
+
+        case OP_ERROR:
+            return (StatusCode) instruction->status;
+
+        case OP_EXIT:
+            return OK;
+    }
+
+    return ERROR_INVALID_COMMAND;
+}
+
+void report_status(StatusCode status, FILE *out) {
+    switch (status) {
+        case OK:
+            break;
+        case ERROR_MEMORY:
+            fprintf(out, "Memory allocation error\n");
+            break;
+        case ERROR_INVALID_INDEX:
+            fprintf(out, "Invalid index\n");
+            break;
+        case ERROR_FILE_OPEN:
+            fprintf(out, "Cannot open file\n");
+            break;
+        case ERROR_FILE_READ:
+            fprintf(out, "File read error\n");
+            break;
+        case ERROR_FILE_WRITE:
+            fprintf(out, "File write error\n");
+            break;
+        case ERROR_INVALID_COMMAND:
+            fprintf(out, "Invalid command\n");
+            break;
+        case ERROR_INVALID_ARRAY_NAME:
+            fprintf(out, "Invalid array name\n");
+            break;
+        case ERROR_INVALID_PARAMS:
+            fprintf(out, "Invalid parameters\n");
+            break;
+        case ERROR_ARRAY_NOT_FOUND:
+            fprintf(out, "Array not found\n");
+            break;
+        default:
+            fprintf(out, "Unknown Error\n");
+            break;
+    }
+}
+
+// Ресурсы для анализа зависимостей: 26 массивов и файлы.
+// Генератор у каждого массива свой, поэтому отдельным ресурсом он не считается
+#define RESOURCE_FILES MAX_ARRAYS
+#define RESOURCE_COUNT (MAX_ARRAYS + 1)
+
+// Что инструкция читает и что меняет, битовыми масками ресурсов.
+// stats тоже пишет: он обновляет кеш статистики массива
+static void instruction_access(const Instruction *instruction, uint32_t *reads, uint32_t *writes) {
+    uint32_t array = 1u << instruction->array;
+    uint32_t target = 1u << instruction->target;
+    *reads = 0;
+    *writes = 0;
+
+    switch ((Opcode) instruction->opcode) {
+        case OP_LOAD:
+            *reads = 1u << RESOURCE_FILES;
+            *writes = array;
+            break;
+        case OP_SAVE:
+            *reads = array;
+            *writes = 1u << RESOURCE_FILES;
+            break;
+        case OP_CONCAT:
+            *reads = target;
+            *writes = array;
+            break;
+        case OP_COPY:
+            *reads = array;
+            *writes = target;
+            break;
+        case OP_RAND:
+        case OP_SHUFFLE:
+        case OP_FREE:
+        case OP_REMOVE:
+        case OP_SORT:
+        case OP_STATS:
+            *writes = array;
+            break;
+        case OP_PRINT_ALL:
+        case OP_PRINT_RANGE:
+        case OP_PRINT_INDEX:
+            *reads = array;
+            break;
+        case OP_ERROR:
+        case OP_EXIT:
+            break;
+    }
+}
+
+typedef struct {
+    size_t *items;
+    size_t count;
+    size_t capacity;
+} IndexList;
+
+static StatusCode index_list_push(IndexList *list, size_t value) {
+    if (list->count == list->capacity) {
+        size_t new_capacity = list->capacity ? list->capacity * 2 : 16;
+        size_t *new_items = realloc(list->items, new_capacity * sizeof(size_t));
+        if (!new_items) return ERROR_MEMORY;
+        list->items = new_items;
+        list->capacity = new_capacity;
+    }
+    list->items[list->count++] = value;
+    return OK;
+}
+
+// Граф зависимостей в виде CSR: successors[offsets[i]..offsets[i + 1]) ждут инструкцию i.
+// Чтение ждёт последней записи ресурса, запись ждёт и её, и всех чтений после неё
+typedef struct {
+    size_t *offsets;
+    size_t *successors;
+    size_t *pending;
+} DependencyGraph;
+
+static void free_dependency_graph(DependencyGraph *graph) {
+    free(graph->offsets);
+    free(graph->successors);
+    free(graph->pending);
+}
+
+static StatusCode build_dependency_graph(const Program *program, size_t count, DependencyGraph *graph) {
+    IndexList edges = {0};
+    IndexList readers[RESOURCE_COUNT] = {{0}};
+    size_t last_writer[RESOURCE_COUNT];
+    StatusCode status = OK;
+
+    for (int r = 0; r < RESOURCE_COUNT; r++) {
+        last_writer[r] = SIZE_MAX;
+    }
+    graph->offsets = calloc(count + 1, sizeof(size_t));
+    graph->pending = calloc(count, sizeof(size_t));
+    graph->successors = NULL;
+    if (!graph->offsets || !graph->pending) status = ERROR_MEMORY;
+
+    // Рёбра копятся парами (откуда, куда), потом раскладываются по источникам
+    for (size_t i = 0; i < count && status == OK; i++) {
+        uint32_t reads, writes;
+        instruction_access(&program->code[i], &reads, &writes);
+
+        for (int r = 0; r < RESOURCE_COUNT && status == OK; r++) {
+            uint32_t bit = 1u << r;
+            if (!((reads | writes) & bit)) continue;
+            if (last_writer[r] != SIZE_MAX && last_writer[r] != i) {
+                if (index_list_push(&edges, last_writer[r]) != OK || index_list_push(&edges, i) != OK) {
+                    status = ERROR_MEMORY;
+                }
+            }
+            if (writes & bit) {
+                for (size_t k = 0; k < readers[r].count && status == OK; k++) {
+                    if (readers[r].items[k] == i) continue;
+                    if (index_list_push(&edges, readers[r].items[k]) != OK || index_list_push(&edges, i) != OK) {
+                        status = ERROR_MEMORY;
+                    }
+                }
+            }
+        }
+        for (int r = 0; r < RESOURCE_COUNT && status == OK; r++) {
+            uint32_t bit = 1u << r;
+            if (writes & bit) {
+                last_writer[r] = i;
+                readers[r].count = 0;
+            } else if (reads & bit) {
+                status = index_list_push(&readers[r], i);
+            }
+        }
     }
 
-    if (strcmp(cmd, "free") == 0) {
-        free_array(array);
-        return init_array(array);
+    size_t edge_count = edges.count / 2;
+    if (status == OK) {
+        graph->successors = malloc((edge_count ? edge_count : 1) * sizeof(size_t));
+        if (!graph->successors) status = ERROR_MEMORY;
     }
+    if (status == OK) {
+        for (size_t e = 0; e < edge_count; e++) {
+            graph->offsets[edges.items[2 * e] + 1]++;
+            graph->pending[edges.items[2 * e + 1]]++;
+        }
+        for (size_t i = 0; i < count; i++) {
+            graph->offsets[i + 1] += graph->offsets[i];
+        }
+        size_t *cursor = malloc((count ? count : 1) * sizeof(size_t));
+        if (!cursor) {
+            status = ERROR_MEMORY;
+        } else {
+            memcpy(cursor, graph->offsets, count * sizeof(size_t));
+            for (size_t e = 0; e < edge_count; e++) {
+                graph->successors[cursor[edges.items[2 * e]]++] = edges.items[2 * e + 1];
+            }
+            free(cursor);
+        }
+    }
+
+    free(edges.items);
+    for (int r = 0; r < RESOURCE_COUNT; r++) {
+        free(readers[r].items);
+    }
+    if (status != OK) {
+        free_dependency_graph(graph);
+        memset(graph, 0, sizeof(*graph));
+    }
+    return status;
+}
+
+// Пул потоков исполняет готовые инструкции, вывод каждой копится отдельно
+// и печатается главным потоком строго в порядке программы
+typedef struct {
+    ArrayStorage *storage;
+    const Program *program;
+    size_t count;
+    DependencyGraph graph;
+    size_t *ready;
+    size_t ready_head;
+    size_t ready_tail;
+    char **outputs;
+    size_t *output_sizes;
+    unsigned char *done;
+    pthread_mutex_t mutex;
+    pthread_cond_t ready_cond;
+    pthread_cond_t done_cond;
+} Pipeline;
+
+typedef struct {
+    Pipeline *pipeline;
+    FILE *out;
+    char *buffer;
+    size_t buffer_size;
+} PipelineWorker;
+
+static void *pipeline_worker(void *arg) {
+    PipelineWorker *worker = arg;
+    Pipeline *pipeline = worker->pipeline;
 
-    if (strcmp(cmd, "remove") == 0) {
-        int start, count;
-        if (sscanf(command, "%*s %*c , %d , %d", &start, &count) != 2) {
-            return ERROR_INVALID_PARAMS;
+    pthread_mutex_lock(&pipeline->mutex);
+    while (1) {
+        while (pipeline->ready_head == pipeline->ready_tail && pipeline->ready_head < pipeline->count) {
+            pthread_cond_wait(&pipeline->ready_cond, &pipeline->mutex);
+        }
+        if (pipeline->ready_head == pipeline->count) break;
+        size_t index = pipeline->ready[pipeline->ready_head++];
+        pthread_mutex_unlock(&pipeline->mutex);
+
+        const Instruction *instruction = &pipeline->program->code[index];
+        rewind(worker->out);
+        report_status(execute_instruction(pipeline->storage, pipeline->program, instruction, worker->out),
+                      worker->out);
+        fflush(worker->out);
+        off_t length = ftello(worker->out);
+        char *output = NULL;
+        size_t output_size = 0;
+        if (length > 0) {
+            output_size = (size_t) length;
+            output = malloc(output_size);
+            if (output) {
+                memcpy(output, worker->buffer, output_size);
+            } else {
+                output_size = SIZE_MAX;
+            }
         }
 
-        if (start < 0 || start >= array->size || count < 0 || start + count > array->size) {
-            return ERROR_INVALID_INDEX;
+        pthread_mutex_lock(&pipeline->mutex);
+        pipeline->outputs[index] = output;
+        pipeline->output_sizes[index] = output_size;
+        pipeline->done[index] = 1;
+        const DependencyGraph *graph = &pipeline->graph;
+        for (size_t e = graph->offsets[index]; e < graph->offsets[index + 1]; e++) {
+            size_t next = graph->successors[e];
+            if (--graph->pending[next] == 0) {
+                pipeline->ready[pipeline->ready_tail++] = next;
+            }
         }
+        pthread_cond_broadcast(&pipeline->ready_cond);
+        pthread_cond_signal(&pipeline->done_cond);
+    }
+    pthread_mutex_unlock(&pipeline->mutex);
+    return NULL;
+}
 
-        memmove(array->data + start,
-                array->data + start + count,
-                (array->size - start - count) * sizeof(int));
-        array->size -= count;
+static StatusCode run_pipeline(ArrayStorage *storage, const Program *program, size_t count, size_t threads) {
+    Pipeline pipeline = {0};
+    PipelineWorker workers[MAX_PIPELINE_THREADS] = {{0}};
+    pthread_t handles[MAX_PIPELINE_THREADS];
+    size_t started = 0;
 
-        return OK;
+    pipeline.storage = storage;
+    pipeline.program = program;
+    pipeline.count = count;
+    StatusCode status = build_dependency_graph(program, count, &pipeline.graph);
+    if (status != OK) return status;
+
+    pipeline.ready = malloc(count * sizeof(size_t));
+    pipeline.outputs = calloc(count, sizeof(char *));
+    pipeline.output_sizes = calloc(count, sizeof(size_t));
+    pipeline.done = calloc(count, 1);
+    if (!pipeline.ready || !pipeline.outputs || !pipeline.output_sizes || !pipeline.done) {
+        status = ERROR_MEMORY;
+    }
+    for (size_t t = 0; t < threads && status == OK; t++) {
+        workers[t].pipeline = &pipeline;
+        workers[t].out = open_memstream(&workers[t].buffer, &workers[t].buffer_size);
+        if (!workers[t].out) status = ERROR_MEMORY;
     }
 
-    if (strcmp(cmd, "copy") == 0) {
-        int start, end;
-        char dest_array_name;
-        if (sscanf(command, "%*s %*c , %d , %d , %c", &start, &end, &dest_array_name) != 3) {
-            return ERROR_INVALID_PARAMS;
+    if (status == OK) {
+        for (size_t i = 0; i < count; i++) {
+            if (pipeline.graph.pending[i] == 0) {
+                pipeline.ready[pipeline.ready_tail++] = i;
+            }
         }
+        pthread_mutex_init(&pipeline.mutex, NULL);
+        pthread_cond_init(&pipeline.ready_cond, NULL);
+        pthread_cond_init(&pipeline.done_cond, NULL);
+        while (started < threads && pthread_create(&handles[started], NULL, pipeline_worker,
+                                                   &workers[started]) == 0) {
+            started++;
+        }
+        // Без единого рабочего потока главный поток исполняет всё сам
+        if (started == 0) pipeline_worker(&workers[0]);
 
-        if (start < 0 || end >= array->size || start > end) {
-            return ERROR_INVALID_INDEX;
+        pthread_mutex_lock(&pipeline.mutex);
+        for (size_t i = 0; i < count; i++) {
+            while (!pipeline.done[i]) {
+                pthread_cond_wait(&pipeline.done_cond, &pipeline.mutex);
+            }
+            char *output = pipeline.outputs[i];
+            size_t output_size = pipeline.output_sizes[i];
+            pipeline.outputs[i] = NULL;
+            pthread_mutex_unlock(&pipeline.mutex);
+            if (output_size == SIZE_MAX) {
+                report_status(ERROR_MEMORY, stdout);
+            } else if (output_size > 0) {
+                fwrite(output, 1, output_size, stdout);
+            }
+            free(output);
+            pthread_mutex_lock(&pipeline.mutex);
         }
+        pthread_mutex_unlock(&pipeline.mutex);
 
-        int dest_idx = get_array_index(dest_array_name);
-        if (dest_idx < 0) return ERROR_INVALID_ARRAY_NAME;
+        for (size_t t = 0; t < started; t++) {
+            pthread_join(handles[t], NULL);
+        }
+        pthread_cond_destroy(&pipeline.done_cond);
+        pthread_cond_destroy(&pipeline.ready_cond);
+        pthread_mutex_destroy(&pipeline.mutex);
+    }
 
-        Array *dest_array = &storage->arrays[dest_idx];
-        int count = end - start + 1;
+    for (size_t t = 0; t < threads; t++) {
+        if (workers[t].out) fclose(workers[t].out);
+        free(workers[t].buffer);
+    }
+    free(pipeline.ready);
+    free(pipeline.outputs);
+    free(pipeline.output_sizes);
+    free(pipeline.done);
+    free_dependency_graph(&pipeline.graph);
+    return status;
+}
 
-        StatusCode status = ensure_capacity(dest_array, count);
-        if (status != OK) return status;
+// Скрипт до первого exit исполняется конвейером, если есть больше одного потока;
+// иначе или при нехватке памяти на граф — последовательно
+void run_program(ArrayStorage *storage, const Program *program, size_t threads) {
+    size_t count = 0;
+    while (count < program->count && program->code[count].opcode != OP_EXIT) {
+        count++;
+    }
+    if (threads > MAX_PIPELINE_THREADS) threads = MAX_PIPELINE_THREADS;
+    if (threads > 1 && count > 1 && run_pipeline(storage, program, count, threads) == OK) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        report_status(execute_instruction(storage, program, &program->code[i], stdout), stdout);
+    }
+}
 
-        memcpy(dest_array->data, array->data + start, count * sizeof(int));
-        dest_array->size = count;
+uint64_t fnv1a(const char *data, size_t size) {
+    uint64_t hash = UINT64_C(14695981039346656037);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char) data[i];
+        hash *= UINT64_C(1099511628211);
+    }
+    return hash;
+}
 
-        return OK;
+// Кеш включается только явно через SCRIPT_CACHE_DIR: ключ предсказуем, и в общем каталоге
+// вроде /tmp чужой процесс мог бы подложить свой байткод. 0 — кеш выключен
+int bytecode_cache_path(char *path, size_t path_size, uint64_t key) {
+    const char *dir = getenv("SCRIPT_CACHE_DIR");
+    if (!dir || !*dir) return 0;
+    int length = snprintf(path, path_size, "%s/script-%016llx.abc", dir, (unsigned long long) key);
+    return length > 0 && (size_t) length < path_size;
+}
+
+// Любая несостыковка заголовка — промах, скрипт компилируется заново.
+// Файл должен быть обычным и принадлежать текущему пользователю
+int load_bytecode(Program *program, const char *path, uint64_t key, size_t script_size) {
+    int fd = open(path, O_RDONLY | O_NOFOLLOW);
+    if (fd == -1) return 0;
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1 || !S_ISREG(file_stat.st_mode) || file_stat.st_uid != geteuid()) {
+        close(fd);
+        return 0;
+    }
+    FILE *file = fdopen(fd, "rb");
+    if (!file) {
+        close(fd);
+        return 0;
     }
 
-    if (strcmp(cmd, "sort") == 0) {
-        char direction;
-        if (sscanf(command, "%*s %*c%c", &direction) != 1) {
-            return ERROR_INVALID_PARAMS;
+    BytecodeHeader header;
+    int ok = fread(&header, sizeof(header), 1, file) == 1 &&
+             memcmp(header.magic, BYTECODE_MAGIC, 4) == 0 &&
+             header.instruction_size == sizeof(Instruction) &&
+             header.key == key && header.script_size == script_size &&
+             header.count <= SIZE_MAX / sizeof(Instruction);
+
+    if (ok) {
+        program->count = program->capacity = (size_t) header.count;
+        program->pool_size = program->pool_capacity = (size_t) header.pool_size;
+        program->code = malloc(program->count * sizeof(Instruction) + 1);
+        program->pool = malloc(program->pool_size + 1);
+        ok = program->code && program->pool &&
+             fread(program->code, sizeof(Instruction), program->count, file) == program->count &&
+             fread(program->pool, 1, program->pool_size, file) == program->pool_size &&
+             fgetc(file) == EOF;
+    }
+
+    // Операнды не доверяем файлу вслепую: смещения в пул и номера массивов проверяем
+    for (size_t i = 0; ok && i < program->count; i++) {
+        const Instruction *instruction = &program->code[i];
+        ok = instruction->opcode <= OP_EXIT && instruction->array < MAX_ARRAYS && instruction->target < MAX_ARRAYS;
+        if (ok && (instruction->opcode == OP_LOAD || instruction->opcode == OP_SAVE)) {
+            ok = instruction->a >= 0 && (size_t) instruction->a < program->pool_size &&
+                 memchr(program->pool + instruction->a, '\0', program->pool_size - (size_t) instruction->a) != NULL;
         }
-        return cmd_sort(array, direction == '+');
     }
 
-    if (strcmp(cmd, "shuffle") == 0) {
-        return cmd_shuffle(array);
+    fclose(file);
+    if (!ok) {
+        free_program(program);
+    }
+    return ok;
+}
+
+// Временный файл и rename, чтобы параллельные запуски не прочитали половину
+void save_bytecode(const Program *program, const char *path, uint64_t key, size_t script_size) {
+    char temp_path[PATH_MAX];
+    if (snprintf(temp_path, sizeof(temp_path), "%s.%ld.tmp", path, (long) getpid()) >= (int) sizeof(temp_path)) {
+        return;
     }
 
-    if (strcmp(cmd, "stats") == 0) {
-        return cmd_stats(array);
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW, 0600);
+    if (fd == -1) return;
+    FILE *file = fdopen(fd, "wb");
+    if (!file) {
+        close(fd);
+        remove(temp_path);
+        return;
     }
 
-    if (strcmp(cmd, "print") == 0) {
-        char param[10];
-        if (sscanf(command, "%*s %*c , %s", param) == 1) {
-            if (strcmp(param, "all") == 0) {
-                return cmd_print(array, 0, array->size - 1);
-            }
-            int start, end;
-            if (sscanf(command, "%*s %*c , %d , %d", &start, &end) == 2) {
-                return cmd_print(array, start, end);
-            }
-            int index;
-            if (sscanf(param, "%d", &index) == 1) {
-                if (index < 0 || index >= array->size) {
-                    return ERROR_INVALID_INDEX;
-                }
-                printf("%d\n", array->data[index]);
-                return OK;
+    BytecodeHeader header = {BYTECODE_MAGIC_INIT, (uint32_t) sizeof(Instruction), key, script_size,
+                             program->count, program->pool_size};
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(program->code, sizeof(Instruction), program->count, file) == program->count &&
+             fwrite(program->pool, 1, program->pool_size, file) == program->pool_size;
+    ok = fclose(file) == 0 && ok;
+
+    if (!ok || rename(temp_path, path) != 0) {
+        remove(temp_path);
+    }
+}
+
+// Режет текст на строки так же, как fgets в интерактивном цикле: не длиннее буфера
+size_t next_command(const char *text, size_t size, size_t pos, char *command) {
+    size_t length = 0;
+    while (pos < size && length < MAX_COMMAND_LENGTH - 1) {
+        char c = text[pos++];
+        command[length++] = c;
+        if (c == '\n') break;
+    }
+    command[length] = '\0';
+    command[strcspn(command, "\n")] = 0;
+    return pos;
+}
+
+StatusCode compile_script(Program *program, const char *text, size_t size) {
+    char command[MAX_COMMAND_LENGTH];
+    size_t pos = 0;
+
+    while (pos < size) {
+        pos = next_command(text, size, pos, command);
+        StatusCode status = compile_command(program, command);
+        if (status != OK) return status;
+    }
+    return OK;
+}
+
+StatusCode read_whole_file(const char *filename, char **text, size_t *size) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) return ERROR_FILE_OPEN;
+
+    size_t capacity = 4096;
+    *size = 0;
+    *text = malloc(capacity);
+    if (!*text) {
+        fclose(file);
+        return ERROR_MEMORY;
+    }
+
+    size_t read;
+    while ((read = fread(*text + *size, 1, capacity - *size, file)) > 0) {
+        *size += read;
+        if (*size == capacity) {
+            char *new_text = realloc(*text, capacity * 2);
+            if (!new_text) {
+                free(*text);
+                fclose(file);
+                return ERROR_MEMORY;
             }
+            *text = new_text;
+            capacity *= 2;
         }
+    }
+
+    int failed = ferror(file);
+    fclose(file);
+    if (failed) {
+        free(*text);
+        return ERROR_FILE_READ;
+    }
+    return OK;
+}
 
+// Скрипт компилируется один раз, байткод кешируется по хешу текста
+StatusCode run_script(ArrayStorage *storage, const char *filename, size_t threads) {
+    char *text;
+    size_t size;
+    StatusCode status = read_whole_file(filename, &text, &size);
+    if (status != OK) return status;
+
+    uint64_t key = fnv1a(text, size);
+    char path[PATH_MAX];
+    int cached = bytecode_cache_path(path, sizeof(path), key);
 
-        return ERROR_INVALID_PARAMS;
+    Program program = {0};
+    if (!cached || !load_bytecode(&program, path, key, size)) {
+        status = compile_script(&program, text, size);
+        if (status == OK && cached) {
+            save_bytecode(&program, path, key, size);
+        }
     }
+    free(text);
 
-    return ERROR_INVALID_COMMAND;
+    if (status == OK) {
+        run_program(storage, &program, threads);
+    }
+    free_program(&program);
+    return status;
+}
+
+static double elapsed_ms(struct timespec start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) (now.tv_sec - start.tv_sec) * 1000.0 + (double) (now.tv_nsec - start.tv_nsec) / 1e6;
 }
 
-int main() {
+// Сравнивает qsort, поразрядную и сэмпл-сорт на одном и том же случайном массиве
+StatusCode run_sort_benchmark(size_t n, size_t threads, Rng *rng) {
+    int *source = malloc(n * sizeof(int));
+    int *work = malloc(n * sizeof(int));
+    int *expected = malloc(n * sizeof(int));
+    int *scratch = malloc(n * sizeof(int));
+    if (!source || !work || !expected || !scratch) {
+        free(source);
+        free(work);
+        free(expected);
+        free(scratch);
+        return ERROR_MEMORY;
+    }
+
+    fill_uniform(source, n, INT_MIN, INT_MAX, rng);
+
+    struct timespec start;
+    memcpy(expected, source, n * sizeof(int));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    qsort(expected, n, sizeof(int), compare_asc);
+    printf("qsort:            %10.2f ms\n", elapsed_ms(start));
+
+    memcpy(work, source, n * sizeof(int));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    radix_sort(work, scratch, n);
+    printf("radix sort:       %10.2f ms%s\n", elapsed_ms(start),
+           memcmp(work, expected, n * sizeof(int)) == 0 ? "" : "  MISMATCH");
+
+    StatusCode status = OK;
+    if (threads > 1 && n >= threads * SAMPLE_OVERSAMPLING) {
+        memcpy(work, source, n * sizeof(int));
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        status = parallel_sample_sort(work, n, threads);
+        printf("sample sort (%2zu): %10.2f ms%s\n", threads, elapsed_ms(start),
+               status == OK && memcmp(work, expected, n * sizeof(int)) == 0 ? "" : "  MISMATCH");
+    }
+
+    free(source);
+    free(work);
+    free(expected);
+    free(scratch);
+    return status;
+}
+
+int main(int argc, char *argv[]) {
     ArrayStorage storage = {0};
-    srand(time(NULL));
+
+    // --seed N перед остальными аргументами делает rand и shuffle воспроизводимыми
+    uint64_t seed = (uint64_t) time(NULL);
+    if (argc >= 3 && strcmp(argv[1], "--seed") == 0) {
+        seed = strtoull(argv[2], NULL, 10);
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+    seed_storage(&storage, seed);
 
     for (int i = 0; i < MAX_ARRAYS; i++) {
         StatusCode status = init_array(&storage.arrays[i]);
@@ -452,51 +2105,49 @@ int main() {
         storage.initialized[i] = 1;
     }
 
-    char command[MAX_COMMAND_LENGTH];
-    while (1) {
-        printf("> ");
-        if (!fgets(command, sizeof(command), stdin)) break;
-
-        command[strcspn(command, "\n")] = 0;
-
-        if (strcmp(command, "exit") == 0) break;
-
-        StatusCode status = process_command(&storage, command);
-        switch (status) {
-            case OK:
-                break;
-            case ERROR_MEMORY:
-                printf("Memory allocation error\n");
-                break;
-            case ERROR_INVALID_INDEX:
-                printf("Invalid index\n");
-                break;
-            case ERROR_FILE_OPEN:
-                printf("Cannot open file\n");
-                break;
-            case ERROR_FILE_READ:
-                printf("File read error\n");
-                break;
-            case ERROR_FILE_WRITE:
-                printf("File write error\n");
-                break;
-            case ERROR_INVALID_COMMAND:
-                printf("Invalid command\n");
-                break;
-            case ERROR_INVALID_ARRAY_NAME:
-                printf("Invalid array name\n");
-                break;
-            case ERROR_INVALID_PARAMS:
-                printf("Invalid parameters\n");
-                break;
-            case ERROR_ARRAY_NOT_FOUND:
-                printf("Array not found\n");
-                break;
-            default:
-                printf("Unknown Error\n");
-                break;
+    StatusCode script_status = OK;
+    if ((argc == 3 || argc == 4) && strcmp(argv[1], "--bench") == 0) {
+        long count = strtol(argv[2], NULL, 10);
+        long threads = argc == 4 ? strtol(argv[3], NULL, 10) : (long) sort_thread_count();
+        if (count <= 0 || threads <= 0 || threads > MAX_SORT_THREADS) {
+            printf("Usage: %s --bench <count> [threads]\n", argv[0]);
+            script_status = ERROR_INVALID_PARAMS;
+        } else {
+            script_status = run_sort_benchmark((size_t) count, (size_t) threads, &storage.rngs[0]);
+            report_status(script_status, stdout);
         }
-
+    } else if (argc == 4 && strcmp(argv[1], "--threads") == 0) {
+        long threads = strtol(argv[2], NULL, 10);
+        if (threads <= 0) {
+            printf("Usage: %s --threads <count> <script>\n", argv[0]);
+            script_status = ERROR_INVALID_PARAMS;
+        } else {
+            script_status = run_script(&storage, argv[3], (size_t) threads);
+            report_status(script_status, stdout);
+        }
+    } else if (argc == 2) {
+        script_status = run_script(&storage, argv[1], sort_thread_count());
+        report_status(script_status, stdout);
+    } else {
+        Program program = {0};
+        char command[MAX_COMMAND_LENGTH];
+        while (1) {
+            printf("> ");
+            if (!fgets(command, sizeof(command), stdin)) break;
+
+            command[strcspn(command, "\n")] = 0;
+
+            if (strcmp(command, "exit") == 0) break;
+
+            program.count = 0;
+            program.pool_size = 0;
+            StatusCode status = compile_command(&program, command);
+            if (status == OK) {
+                status = execute_instruction(&storage, &program, &program.code[0], stdout);
+            }
+            report_status(status, stdout);
+        }
+        free_program(&program);
     }
 
     for (int i = 0; i < MAX_ARRAYS; i++) {
@@ -505,5 +2156,5 @@ int main() {
         }
     }
 
-    return 0;
+    return script_status == OK ? 0 : 1;
 }
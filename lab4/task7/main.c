@@ -1,18 +1,39 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <limits.h>
+#include <stdint.h>
+#include <time.h>
+
+#define INITIAL_TABLE_SIZE 16
+#define MAX_LOAD_PERCENT 75
+#define INITIAL_NAMES_SIZE 4096
 
+// Ячейка — регистр переменной: номер назначается при компиляции, а defined
+// выставляется при первом присваивании во время исполнения. Имя лежит в общем буфере имён
 typedef struct {
-    char *name;
+    size_t name_offset;
+    uint64_t hash;
     int value;
+    int defined;
 } MemoryCell;
 
+// Хеш-таблица с открытой адресацией хранит номер ячейки + 1, ноль — пустой слот.
+// Отсортированный по именам порядок строится только для print и живёт до появления новой ячейки
 typedef struct {
     MemoryCell *cells;
     size_t capacity;
     size_t size;
+    size_t *slots;
+    size_t slot_count;
+    char *names;
+    size_t names_size;
+    size_t names_capacity;
+    size_t *sorted;
+    size_t sorted_size;
 } Interpreter;
 
 typedef enum {
@@ -74,57 +95,111 @@ StatusCode safe_strtol(const char *str, int *result) {
     return SUCCESS;
 }
 
-int compare_cells(const void *a, const void *b) {
-    const MemoryCell *cell_a = (const MemoryCell *) a;
-    const MemoryCell *cell_b = (const MemoryCell *) b;
-    return strcmp(cell_a->name, cell_b->name);
+static inline const char *cell_name(const Interpreter *interpreter, size_t index) {
+    return interpreter->names + interpreter->cells[index].name_offset;
 }
 
+uint64_t hash_name(const char *name, size_t length) {
+    uint64_t hash = UINT64_C(14695981039346656037);
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char) name[i];
+        hash *= UINT64_C(1099511628211);
+    }
+    return hash;
+}
 
 StatusCode interpreter_init(Interpreter *interpreter) {
+    memset(interpreter, 0, sizeof(*interpreter));
     interpreter->capacity = 10;
-    interpreter->size = 0;
     interpreter->cells = malloc(interpreter->capacity * sizeof(MemoryCell));
+    interpreter->slot_count = INITIAL_TABLE_SIZE;
+    interpreter->slots = calloc(interpreter->slot_count, sizeof(size_t));
 
-    if (!interpreter->cells) {
+    if (!interpreter->cells || !interpreter->slots) {
+        free(interpreter->cells);
+        free(interpreter->slots);
         return ERROR_MEMORY_ALLOCATION;
     }
 
     return SUCCESS;
 }
 
+static size_t *find_slot(const Interpreter *interpreter, const char *name, uint64_t hash) {
+    size_t mask = interpreter->slot_count - 1;
+    size_t i = (size_t) hash & mask;
 
-StatusCode find_variable(const Interpreter *interpreter, const char *name, int *index) {
-    int left = 0;
-    int right = (int) interpreter->size - 1;
+    while (interpreter->slots[i]) {
+        size_t index = interpreter->slots[i] - 1;
+        if (interpreter->cells[index].hash == hash && strcmp(cell_name(interpreter, index), name) == 0) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return &interpreter->slots[i];
+}
 
-    while (left <= right) {
-        int mid = (left + right) / 2;
-        int cmp = strcmp(interpreter->cells[mid].name, name);
+static StatusCode grow_table(Interpreter *interpreter) {
+    size_t new_count = interpreter->slot_count * 2;
+    size_t *new_slots = calloc(new_count, sizeof(size_t));
+    if (!new_slots) {
+        return ERROR_MEMORY_ALLOCATION;
+    }
 
-        if (cmp == 0) {
-            *index = mid;
-            return SUCCESS;
+    size_t mask = new_count - 1;
+    for (size_t index = 0; index < interpreter->size; index++) {
+        size_t i = (size_t) interpreter->cells[index].hash & mask;
+        while (new_slots[i]) {
+            i = (i + 1) & mask;
         }
+        new_slots[i] = index + 1;
+    }
+
+    free(interpreter->slots);
+    interpreter->slots = new_slots;
+    interpreter->slot_count = new_count;
+    return SUCCESS;
+}
 
-        if (cmp < 0) {
-            left = mid + 1;
-        } else {
-            right = mid - 1;
+// Дописывает строку с завершающим нулём в растущий буфер, *offset — где она начинается
+static StatusCode append_string(char **buffer, size_t *size, size_t *capacity, const char *str, size_t length,
+                                size_t *offset) {
+    if (*size + length + 1 > *capacity) {
+        size_t new_capacity = *capacity ? *capacity : INITIAL_NAMES_SIZE;
+        while (*size + length + 1 > new_capacity) {
+            new_capacity *= 2;
         }
+        char *new_buffer = realloc(*buffer, new_capacity);
+        if (!new_buffer) {
+            return ERROR_MEMORY_ALLOCATION;
+        }
+        *buffer = new_buffer;
+        *capacity = new_capacity;
     }
 
-    *index = left;
-    return ERROR_VARIABLE_NOT_FOUND;
+    memcpy(*buffer + *size, str, length + 1);
+    *offset = *size;
+    *size += length + 1;
+    return SUCCESS;
 }
 
-StatusCode add_variable(Interpreter *interpreter, const char *name, int value) {
-    int index;
-    if (find_variable(interpreter, name, &index) == SUCCESS) {
-        interpreter->cells[index].value = value;
+// Номер регистра для имени; новая ячейка заводится ещё не определённой
+StatusCode intern_variable(Interpreter *interpreter, const char *name, int *index) {
+    size_t length = strlen(name);
+    uint64_t hash = hash_name(name, length);
+    size_t *slot = find_slot(interpreter, name, hash);
+    if (*slot) {
+        *index = (int) (*slot - 1);
         return SUCCESS;
     }
 
+    if ((interpreter->size + 1) * 100 > interpreter->slot_count * MAX_LOAD_PERCENT) {
+        StatusCode status = grow_table(interpreter);
+        if (status != SUCCESS) {
+            return status;
+        }
+        slot = find_slot(interpreter, name, hash);
+    }
+
     if (interpreter->size == interpreter->capacity) {
         size_t new_capacity = interpreter->capacity * 2;
         MemoryCell *new_cells = realloc(interpreter->cells, new_capacity * sizeof(MemoryCell));
@@ -137,27 +212,59 @@ StatusCode add_variable(Interpreter *interpreter, const char *name, int value) {
         interpreter->capacity = new_capacity;
     }
 
-    interpreter->cells[interpreter->size].name = strdup(name);
-    if (!interpreter->cells[interpreter->size].name) {
-        return ERROR_MEMORY_ALLOCATION;
+    MemoryCell *cell = &interpreter->cells[interpreter->size];
+    StatusCode status = append_string(&interpreter->names, &interpreter->names_size, &interpreter->names_capacity,
+                                      name, length, &cell->name_offset);
+    if (status != SUCCESS) {
+        return status;
     }
-    interpreter->cells[interpreter->size].value = value;
+    cell->hash = hash;
+    cell->value = 0;
+    cell->defined = 0;
+    *index = (int) interpreter->size;
     interpreter->size++;
-
-    qsort(interpreter->cells, interpreter->size, sizeof(MemoryCell), compare_cells);
+    *slot = interpreter->size;
 
     return SUCCESS;
 }
 
-StatusCode get_variable_value(const Interpreter *interpreter, const char *name, int *value) {
-    int index;
-    StatusCode status = find_variable(interpreter, name, &index);
+typedef struct {
+    const char *name;
+    size_t index;
+} SortEntry;
 
-    if (status == SUCCESS) {
-        *value = interpreter->cells[index].value;
+int compare_entries(const void *a, const void *b) {
+    return strcmp(((const SortEntry *) a)->name, ((const SortEntry *) b)->name);
+}
+
+// Порядок по именам для print: пересчитывается, только если с прошлого раза появились переменные
+StatusCode sort_variables(Interpreter *interpreter) {
+    if (interpreter->sorted_size == interpreter->size) {
+        return SUCCESS;
     }
 
-    return status;
+    size_t *new_sorted = realloc(interpreter->sorted, (interpreter->size ? interpreter->size : 1) * sizeof(size_t));
+    SortEntry *entries = malloc((interpreter->size ? interpreter->size : 1) * sizeof(SortEntry));
+    if (new_sorted) {
+        interpreter->sorted = new_sorted;
+    }
+    if (!new_sorted || !entries) {
+        free(entries);
+        return ERROR_MEMORY_ALLOCATION;
+    }
+
+    for (size_t i = 0; i < interpreter->size; i++) {
+        entries[i].name = cell_name(interpreter, i);
+        entries[i].index = i;
+    }
+    qsort(entries, interpreter->size, sizeof(SortEntry), compare_entries);
+    for (size_t i = 0; i < interpreter->size; i++) {
+        interpreter->sorted[i] = entries[i].index;
+    }
+    free(entries);
+
+    interpreter->sorted_size = interpreter->size;
+    return SUCCESS;
 }
 
 StatusCode check_arithmetic_overflow(int a, int b, char op, int *result) {
@@ -222,67 +329,119 @@ StatusCode check_arithmetic_overflow(int a, int b, char op, int *result) {
     return SUCCESS;
 }
 
-void print_all_variables(const Interpreter *interpreter) {
+StatusCode print_all_variables(Interpreter *interpreter) {
+    StatusCode status = sort_variables(interpreter);
+    if (status != SUCCESS) {
+        return status;
+    }
     for (size_t i = 0; i < interpreter->size; i++) {
-        printf("%s = %d\n", interpreter->cells[i].name, interpreter->cells[i].value);
+        size_t index = interpreter->sorted[i];
+        if (!interpreter->cells[index].defined) continue;
+        printf("%s = %d\n", cell_name(interpreter, index), interpreter->cells[index].value);
     }
+    return SUCCESS;
 }
 
-StatusCode
-process_arithmetic(const char *left_str, const char *right_str, char op, int *result, const Interpreter *interpreter) {
-    int left_val, right_val;
-    StatusCode status;
+// Операнд трёхадресной команды: регистр переменной, готовая константа
+// или литерал, который не разобрался, — его ошибка всплывёт только при исполнении.
+// У такого литерала в value смещение его текста в пуле программы
+typedef enum {
+    OPERAND_VARIABLE,
+    OPERAND_CONSTANT,
+    OPERAND_INVALID
+} OperandKind;
 
-    if (isdigit(*left_str) || *left_str == '-' || *left_str == '+') {
-        status = safe_strtol(left_str, &left_val);
-    } else {
-        status = get_variable_value(interpreter, left_str, &left_val);
-        if (status == ERROR_VARIABLE_NOT_FOUND) {
-            printf("Error: Undefined variable '%s'\n", left_str);
-            return ERROR_VARIABLE_NOT_FOUND;
+typedef struct {
+    uint8_t kind;
+    uint8_t status;
+    int value;
+} Operand;
+
+typedef enum {
+    OP_ASSIGN,
+    OP_ARITHMETIC,
+    OP_PRINT,
+    OP_PRINT_ALL,
+    OP_ERROR
+} Opcode;
+
+// target = left или target = left op right; для OP_ERROR ошибка разбора строки лежит в left.status
+typedef struct {
+    uint8_t opcode;
+    char op;
+    int line;
+    int target;
+    Operand left;
+    Operand right;
+} Instruction;
+
+// Тексты неразобранных литералов нужны только для сообщений об ошибках
+typedef struct {
+    Instruction *code;
+    size_t count;
+    size_t capacity;
+    char *text;
+    size_t text_size;
+    size_t text_capacity;
+} Program;
+
+void free_program(Program *program) {
+    free(program->code);
+    free(program->text);
+    memset(program, 0, sizeof(*program));
+}
+
+static StatusCode emit_instruction(Program *program, const Instruction *instruction) {
+    if (program->count == program->capacity) {
+        size_t new_capacity = program->capacity ? program->capacity * 2 : 64;
+        Instruction *new_code = realloc(program->code, new_capacity * sizeof(Instruction));
+        if (!new_code) {
+            return ERROR_MEMORY_ALLOCATION;
         }
+        program->code = new_code;
+        program->capacity = new_capacity;
     }
-    if (status != SUCCESS) {
-        printf("Error evaluating left operand '%s'\n", left_str);
-        return status;
-    }
+    program->code[program->count++] = *instruction;
+    return SUCCESS;
+}
 
-    if (isdigit(*right_str) || *right_str == '-' || *right_str == '+') {
-        status = safe_strtol(right_str, &right_val);
-    } else {
-        status = get_variable_value(interpreter, right_str, &right_val);
-        if (status == ERROR_VARIABLE_NOT_FOUND) {
-            printf("Error: Undefined variable '%s'\n", right_str);
-            return ERROR_VARIABLE_NOT_FOUND;
+static StatusCode compile_operand(Interpreter *interpreter, Program *program, const char *text, Operand *operand) {
+    if (isdigit(*text) || *text == '-' || *text == '+') {
+        StatusCode status = safe_strtol(text, &operand->value);
+        if (status == SUCCESS) {
+            operand->kind = OPERAND_CONSTANT;
+            return SUCCESS;
         }
-    }
-    if (status != SUCCESS) {
-        printf("Error evaluating right operand '%s'\n", right_str);
-        return status;
-    }
+        operand->kind = OPERAND_INVALID;
+        operand->status = (uint8_t) status;
 
-    status = check_arithmetic_overflow(left_val, right_val, op, result);
-    if (status != SUCCESS) {
-        printf("Arithmetic overflow: %d %c %d\n", left_val, op, right_val);
+        size_t offset;
+        if (program->text_size > INT_MAX) {
+            return ERROR_MEMORY_ALLOCATION;
+        }
+        status = append_string(&program->text, &program->text_size, &program->text_capacity, text, strlen(text),
+                               &offset);
+        if (status == SUCCESS) {
+            operand->value = (int) offset;
+        }
         return status;
     }
 
-    return SUCCESS;
+    operand->kind = OPERAND_VARIABLE;
+    return intern_variable(interpreter, text, &operand->value);
 }
 
-StatusCode process_instruction(Interpreter *interpreter, const char *instruction) {
-    char *line = strdup(instruction);
-    if (!line) {
-        return ERROR_MEMORY_ALLOCATION;
-    }
+// Разбирает строку так же, как её раньше разбирали при каждом исполнении.
+// Ошибки разбора не прерывают компиляцию, а становятся командой OP_ERROR
+static StatusCode parse_instruction(Interpreter *interpreter, Program *program, char *line, Instruction *compiled) {
+    compiled->opcode = OP_ERROR;
+    compiled->left.status = ERROR_INVALID_INSTRUCTION;
 
     char *semicolon = strchr(line, ';');
-    if (semicolon) {
-        *semicolon = '\0';
-    } else {
-        free(line);
-        return ERROR_INVALID_INSTRUCTION;
+    if (!semicolon) {
+        return SUCCESS;
     }
+    *semicolon = '\0';
     char *start = line;
     while (isspace(*start)) start++;
     char *end = start + strlen(start) - 1;
@@ -290,28 +449,19 @@ StatusCode process_instruction(Interpreter *interpreter, const char *instruction
 
     if (strncmp(start, "print", 5) == 0) {
         if (strlen(start) == 5) {
-            print_all_variables(interpreter);
-            free(line);
+            compiled->opcode = OP_PRINT_ALL;
             return SUCCESS;
         }
         char *var_name = start + 5;
         while (isspace(*var_name)) var_name++;
 
-        int value;
-        StatusCode status = get_variable_value(interpreter, var_name, &value);
-        if (status == SUCCESS) {
-            printf("%s = %d\n", var_name, value);
-        } else {
-            printf("Error: Variable '%s' not found\n", var_name);
-        }
-        free(line);
-        return status;
+        compiled->opcode = OP_PRINT;
+        return intern_variable(interpreter, var_name, &compiled->target);
     }
 
     char *equals = strchr(start, '=');
     if (!equals) {
-        free(line);
-        return ERROR_INVALID_INSTRUCTION;
+        return SUCCESS;
     }
 
     *equals = '\0';
@@ -328,55 +478,202 @@ StatusCode process_instruction(Interpreter *interpreter, const char *instruction
     end = expression + strlen(expression) - 1;
     while (end > expression && isspace(*end)) *end-- = '\0';
 
-    int result;
-    StatusCode status;
-
     char *expr_ptr = expression;
     if (*expr_ptr == '-' || *expr_ptr == '+') {
         expr_ptr++;
     }
     char *operator = strpbrk(expr_ptr, "+-*/%");
 
+    StatusCode status;
     if (operator) {
-        char op = *operator;
+        compiled->op = *operator;
         *operator = '\0';
-        char *left_str = expression;
         char *right_str = operator + 1;
 
         while (isspace(*right_str)) right_str++;
         end = right_str + strlen(right_str) - 1;
         while (end > right_str && isspace(*end)) *end-- = '\0';
 
-        status = process_arithmetic(left_str, right_str, op, &result, interpreter);
-    } else {
-        if (*expression == '-' || *expression == '+' || isdigit(*expression)) {
-            status = safe_strtol(expression, &result);
-        } else {
-            status = get_variable_value(interpreter, expression, &result);
+        compiled->opcode = OP_ARITHMETIC;
+        status = compile_operand(interpreter, program, expression, &compiled->left);
+        if (status == SUCCESS) {
+            status = compile_operand(interpreter, program, right_str, &compiled->right);
         }
+    } else {
+        compiled->opcode = OP_ASSIGN;
+        status = compile_operand(interpreter, program, expression, &compiled->left);
     }
 
     if (status != SUCCESS) {
-        free(line);
         return status;
     }
+    return intern_variable(interpreter, var_name, &compiled->target);
+}
 
-    status = add_variable(interpreter, var_name, result);
-    free(line);
-    return status;
+// Разбирает строку на месте, содержимое line после вызова испорчено
+StatusCode compile_instruction(Interpreter *interpreter, Program *program, char *line, int line_number) {
+    Instruction compiled = {0};
+    compiled.line = line_number;
+    StatusCode status = parse_instruction(interpreter, program, line, &compiled);
+    if (status != SUCCESS) {
+        return status;
+    }
+    return emit_instruction(program, &compiled);
 }
 
-void interpreter_cleanup(Interpreter *interpreter) {
-    for (size_t i = 0; i < interpreter->size; i++) {
-        free(interpreter->cells[i].name);
+// Значение операнда; side — "left"/"right" для сообщений в арифметике, NULL — молча
+static StatusCode load_operand(const Interpreter *interpreter, const Program *program, const Operand *operand,
+                               const char *side, int *value) {
+    switch ((OperandKind) operand->kind) {
+        case OPERAND_CONSTANT:
+            *value = operand->value;
+            return SUCCESS;
+
+        case OPERAND_VARIABLE: {
+            const MemoryCell *cell = &interpreter->cells[operand->value];
+            if (!cell->defined) {
+                if (side) {
+                    printf("Error: Undefined variable '%s'\n", cell_name(interpreter, (size_t) operand->value));
+                }
+                return ERROR_VARIABLE_NOT_FOUND;
+            }
+            *value = cell->value;
+            return SUCCESS;
+        }
+
+        case OPERAND_INVALID:
+            if (side) {
+                printf("Error evaluating %s operand '%s'\n", side, program->text + operand->value);
+            }
+            return (StatusCode) operand->status;
+    }
+    return ERROR_INVALID_INSTRUCTION;
+}
+
+// Исполняет программу до первой ошибки, в *error_line — строка, на которой она случилась
+StatusCode execute_program(Interpreter *interpreter, const Program *program, int *error_line) {
+    MemoryCell *cells = interpreter->cells;
+
+    for (size_t pc = 0; pc < program->count; pc++) {
+        const Instruction *instruction = &program->code[pc];
+        StatusCode status = SUCCESS;
+        int left = 0, right = 0;
+
+        switch ((Opcode) instruction->opcode) {
+            case OP_ASSIGN:
+                status = load_operand(interpreter, program, &instruction->left, NULL, &left);
+                if (status == SUCCESS) {
+                    cells[instruction->target].value = left;
+                    cells[instruction->target].defined = 1;
+                }
+                break;
+
+            case OP_ARITHMETIC:
+                status = load_operand(interpreter, program, &instruction->left, "left", &left);
+                if (status == SUCCESS) {
+                    status = load_operand(interpreter, program, &instruction->right, "right", &right);
+                }
+                if (status == SUCCESS) {
+                    int result;
+                    status = check_arithmetic_overflow(left, right, instruction->op, &result);
+                    if (status != SUCCESS) {
+                        printf("Arithmetic overflow: %d %c %d\n", left, instruction->op, right);
+                    } else {
+                        cells[instruction->target].value = result;
+                        cells[instruction->target].defined = 1;
+                    }
+                }
+                break;
+
+            case OP_PRINT:
+                if (cells[instruction->target].defined) {
+                    printf("%s = %d\n", cell_name(interpreter, (size_t) instruction->target),
+                           cells[instruction->target].value);
+                } else {
+                    printf("Error: Variable '%s' not found\n", cell_name(interpreter, (size_t) instruction->target));
+                    status = ERROR_VARIABLE_NOT_FOUND;
+                }
+                break;
+
+            case OP_PRINT_ALL:
+                status = print_all_variables(interpreter);
+                break;
+
+            case OP_ERROR:
+                status = (StatusCode) instruction->left.status;
+                break;
+        }
+
+        if (status != SUCCESS) {
+            *error_line = instruction->line;
+            return status;
+        }
     }
+    return SUCCESS;
+}
+
+void interpreter_cleanup(Interpreter *interpreter) {
     free(interpreter->cells);
-    interpreter->cells = NULL;
-    interpreter->size = 0;
-    interpreter->capacity = 0;
+    free(interpreter->slots);
+    free(interpreter->names);
+    free(interpreter->sorted);
+    memset(interpreter, 0, sizeof(*interpreter));
+}
+
+// Компилирует программу из count объявлений и count чтений, исполняет её и один раз сортирует для print
+StatusCode run_benchmark(size_t count) {
+    Interpreter interpreter;
+    if (interpreter_init(&interpreter) != SUCCESS) {
+        return ERROR_MEMORY_ALLOCATION;
+    }
+
+    Program program = {0};
+    char line[64];
+    StatusCode status = SUCCESS;
+    clock_t start = clock();
+    for (size_t i = 0; i < count && status == SUCCESS; i++) {
+        snprintf(line, sizeof(line), "var_%zu = %zu;", i, i % 1000);
+        status = compile_instruction(&interpreter, &program, line, (int) (i + 1));
+    }
+    for (size_t i = 0; i < count && status == SUCCESS; i++) {
+        snprintf(line, sizeof(line), "tmp = 1 + var_%zu;", count - 1 - i);
+        status = compile_instruction(&interpreter, &program, line, (int) (count + i + 1));
+    }
+    double compile_ms = (double) (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+    int error_line = 0;
+    start = clock();
+    if (status == SUCCESS) {
+        status = execute_program(&interpreter, &program, &error_line);
+    }
+    double execute_ms = (double) (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+    start = clock();
+    if (status == SUCCESS) {
+        status = sort_variables(&interpreter);
+    }
+    double sort_ms = (double) (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+    if (status == SUCCESS) {
+        printf("variables: %zu, table: %zu slots, instructions: %zu\n", interpreter.size, interpreter.slot_count,
+               program.count);
+        printf("compile: %.2f ms, execute: %.2f ms, sort for print: %.2f ms\n", compile_ms, execute_ms, sort_ms);
+    }
+    free_program(&program);
+    interpreter_cleanup(&interpreter);
+    return status;
 }
 
 int main(int argc, char *argv[]) {
+    if (argc == 3 && strcmp(argv[1], "--bench") == 0) {
+        long count = strtol(argv[2], NULL, 10);
+        if (count <= 0) {
+            printf("Usage: %s --bench <count>\n", argv[0]);
+            return ERROR_FILE_OPEN;
+        }
+        return (int) run_benchmark((size_t) count);
+    }
+
     if (argc != 2) {
         printf("Usage: %s <input_file>\n", argv[0]);
         return ERROR_FILE_OPEN;
@@ -395,9 +692,12 @@ int main(int argc, char *argv[]) {
         return ERROR_MEMORY_ALLOCATION;
     }
 
+    // Файл компилируется целиком до исполнения. На первой ошибочной строке разбор
+    // останавливается: исполнение дальше неё всё равно не дойдёт
+    Program program = {0};
     char line[256];
     int line_number = 0;
-    StatusCode final_status = SUCCESS;
+    StatusCode compile_status = SUCCESS;
 
     while (fgets(line, sizeof(line), file)) {
         line_number++;
@@ -405,37 +705,47 @@ int main(int argc, char *argv[]) {
             continue;
         }
 
-        StatusCode status = process_instruction(&interpreter, line);
-        if (status != SUCCESS) {
-            printf("Error at line %d: ", line_number);
-            switch (status) {
-                case ERROR_MEMORY_ALLOCATION:
-                    printf("Memory allocation failed\n");
-                    break;
-                case ERROR_INVALID_INSTRUCTION:
-                    printf("Invalid instruction\n");
-                    break;
-                case ERROR_VARIABLE_NOT_FOUND:
-                    printf("Variable not found\n");
-                    break;
-                case ERROR_DIVISION_BY_ZERO:
-                    printf("Division by zero\n");
-                    break;
-                case ERROR_NUMBER_OVERFLOW:
-                    printf("Number overflow\n");
-                    break;
-                case ERROR_INVALID_NUMBER:
-                    printf("Invalid number format\n");
-                    break;
-                default:
-                    printf("Unknown error (code %d)\n", status);
-            }
-            final_status = status;
+        compile_status = compile_instruction(&interpreter, &program, line, line_number);
+        if (compile_status != SUCCESS || program.code[program.count - 1].opcode == OP_ERROR) {
             break;
         }
     }
 
+    int error_line = line_number;
+    StatusCode final_status = execute_program(&interpreter, &program, &error_line);
+    if (final_status == SUCCESS && compile_status != SUCCESS) {
+        final_status = compile_status;
+        error_line = line_number;
+    }
+
+    if (final_status != SUCCESS) {
+        printf("Error at line %d: ", error_line);
+        switch (final_status) {
+            case ERROR_MEMORY_ALLOCATION:
+                printf("Memory allocation failed\n");
+                break;
+            case ERROR_INVALID_INSTRUCTION:
+                printf("Invalid instruction\n");
+                break;
+            case ERROR_VARIABLE_NOT_FOUND:
+                printf("Variable not found\n");
+                break;
+            case ERROR_DIVISION_BY_ZERO:
+                printf("Division by zero\n");
+                break;
+            case ERROR_NUMBER_OVERFLOW:
+                printf("Number overflow\n");
+                break;
+            case ERROR_INVALID_NUMBER:
+                printf("Invalid number format\n");
+                break;
+            default:
+                printf("Unknown error (code %d)\n", final_status);
+        }
+    }
+
     fclose(file);
+    free_program(&program);
     interpreter_cleanup(&interpreter);
 
     return (int) final_status;
@@ -6,6 +6,13 @@
 #include <compare>
 #include <cstring>
 #include <algorithm>
+#include <cstdint>
+#include <string>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 class vector {
 private:
@@ -242,6 +249,210 @@ public:
     iterator end() { return {val + length}; }
 };
 
+// vector, хранящий данные в отображённом в память файле: размер и ёмкость лежат
+// в заголовке файла, поэтому содержимое переживает перезапуск процесса
+class mapped_vector {
+private:
+    struct header {
+        std::uint64_t magic;
+        std::uint64_t length;
+        std::uint64_t cap;
+    };
+
+    static constexpr std::uint64_t MAGIC = 0x31564d5644ULL; // "DVMV1"
+    static constexpr size_t HEADER_SIZE = 64;
+    static constexpr size_t INITIAL_CAPACITY = 16;
+
+    int fd;
+    char *base;
+    size_t mapped_size;
+
+    header *head() const {
+        return reinterpret_cast<header *>(base);
+    }
+
+    static size_t bytes_for(size_t cap) {
+        return HEADER_SIZE + cap * sizeof(double);
+    }
+
+    void remap(size_t cap) {
+        size_t new_size = bytes_for(cap);
+        if (new_size > mapped_size && ftruncate(fd, static_cast<off_t>(new_size)) != 0)
+            throw std::runtime_error("Failed to grow mapped file");
+
+        void *p = mremap(base, mapped_size, new_size, MREMAP_MAYMOVE);
+        if (p == MAP_FAILED)
+            throw std::runtime_error("Failed to remap file");
+
+        if (new_size < mapped_size && ftruncate(fd, static_cast<off_t>(new_size)) != 0) {
+            mapped_size = new_size;
+            base = static_cast<char *>(p);
+            throw std::runtime_error("Failed to shrink mapped file");
+        }
+
+        base = static_cast<char *>(p);
+        mapped_size = new_size;
+        head()->cap = cap;
+    }
+
+public:
+    explicit mapped_vector(const std::string &path) {
+        fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0)
+            throw std::runtime_error("Cannot open " + path);
+
+        struct stat st{};
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw std::runtime_error("Cannot stat " + path);
+        }
+
+        bool fresh = st.st_size == 0;
+        mapped_size = fresh ? bytes_for(INITIAL_CAPACITY) : static_cast<size_t>(st.st_size);
+        if (fresh && ftruncate(fd, static_cast<off_t>(mapped_size)) != 0) {
+            close(fd);
+            throw std::runtime_error("Cannot resize " + path);
+        }
+        if (mapped_size < HEADER_SIZE) {
+            close(fd);
+            throw std::invalid_argument("File is too small to be a mapped_vector");
+        }
+
+        void *p = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Cannot map " + path);
+        }
+        base = static_cast<char *>(p);
+
+        if (fresh) {
+            *head() = {MAGIC, 0, INITIAL_CAPACITY};
+        } else if (head()->magic != MAGIC || head()->length > head()->cap
+                   || bytes_for(head()->cap) > mapped_size) {
+            munmap(base, mapped_size);
+            close(fd);
+            throw std::invalid_argument("File is not a valid mapped_vector");
+        }
+    }
+
+    mapped_vector(const mapped_vector &) = delete;
+
+    mapped_vector &operator=(const mapped_vector &) = delete;
+
+    ~mapped_vector() {
+        munmap(base, mapped_size);
+        close(fd);
+    }
+
+    double &at(size_t index) const {
+        if (index >= size())
+            throw std::invalid_argument("Out of bounds");
+
+        return data()[index];
+    }
+
+    double &front() const {
+        return at(0);
+    }
+
+    double &back() const {
+        return at(size() - 1);
+    }
+
+    double *data() const {
+        return reinterpret_cast<double *>(base + HEADER_SIZE);
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    size_t size() const {
+        return head()->length;
+    }
+
+    size_t capacity() const {
+        return head()->cap;
+    }
+
+    // новые страницы после ftruncate уже заполнены нулями, memset не нужен
+    void reserve(size_t num) {
+        if (num <= capacity())
+            return;
+
+        remap(num);
+    }
+
+    void shrink_to_fit() {
+        if (size() >= capacity())
+            return;
+
+        remap(size());
+    }
+
+    // сбрасывает изменённые страницы на диск
+    void flush() const {
+        if (msync(base, mapped_size, MS_SYNC) != 0)
+            throw std::runtime_error("Failed to sync mapped file");
+    }
+
+    void clear() {
+        head()->length = 0;
+    }
+
+    void insert(size_t index, double elem) {
+        if (index >= capacity()) {
+            reserve(index + 5);
+        } else if (size() + 1 >= capacity()) {
+            reserve(capacity() * 2);
+        }
+
+        double *val = data();
+        size_t old_length = size();
+        head()->length = index > old_length ? index + 1 : old_length + 1;
+
+        if (index < old_length)
+            std::memmove(val + index + 1, val + index, (old_length - index) * sizeof(double));
+
+        val[index] = elem;
+    }
+
+    void erase(size_t index) {
+        if (index >= size())
+            return;
+
+        double *val = data();
+        std::memmove(val + index, val + index + 1, (size() - index - 1) * sizeof(double));
+        head()->length--;
+    }
+
+    void push_back(double elem) {
+        insert(size(), elem);
+    }
+
+    double pop_back() {
+        double res = back();
+        head()->length--;
+        return res;
+    }
+
+    void resize(size_t size, double elem) {
+        if (size > this->size()) {
+            reserve(size);
+            std::fill(data() + this->size(), data() + size, elem);
+        }
+        head()->length = size;
+    }
+
+    bool operator==(const mapped_vector &other) const {
+        return size() == other.size() && std::equal(begin(), end(), other.begin());
+    }
+
+    double *begin() const { return data(); }
+
+    double *end() const { return data() + size(); }
+};
+
 std::ostream &operator<<(std::ostream &ostream, const vector &vector) {
     for (std::size_t i = 0; i < vector.size(); ++i) {
         ostream << vector.at(i) << ' ';
@@ -250,8 +461,24 @@ std::ostream &operator<<(std::ostream &ostream, const vector &vector) {
     return ostream;
 }
 
-int main() {
+std::ostream &operator<<(std::ostream &ostream, const mapped_vector &vector) {
+    for (std::size_t i = 0; i < vector.size(); ++i) {
+        ostream << vector.at(i) << ' ';
+    }
+    ostream << std::endl;
+    return ostream;
+}
+
+int main(int argc, char *argv[]) {
     try {
+        if (argc > 1) {
+            // каждый запуск дописывает число в файл и печатает всё накопленное
+            mapped_vector m(argv[1]);
+            m.push_back(static_cast<double>(m.size()));
+            std::cout << m << m.size() << '\n' << m.capacity() << '\n';
+            return 0;
+        }
+
         vector a(10, 1);
 //
         a.insert(15, 3);
@@ -1,37 +1,191 @@
-#include <regex>
 #include <stdexcept>
 #include <ctime>
 #include <string>
 #include <iostream>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <set>
+#include <unordered_map>
+#include <typeinfo>
+#include <charconv>
+#include <string_view>
+#include <thread>
+#include <fstream>
+#include <cstring>
+#include <exception>
+#include <cstdio>
+#include <shared_mutex>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <memory_resource>
+#include <new>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Число дней от 1970-01-01 до даты григорианского календаря
+long long daysFromCivil(long long year, long long month, long long day) {
+    year -= month <= 2;
+    const long long era = (year >= 0 ? year : year - 399) / 400;
+    const long long yearOfEra = year - era * 400;
+    const long long dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const long long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
 
+// Разбор 'YYYY-MM-DD HH:MM:SS' без regex и временных строк. Смещение часового пояса
+// берётся из mktime один раз на каждый встреченный час и кэшируется в потоке.
 time_t parseDate(const std::string &date) {
-
-    std::regex dateRegex(R"(^\d{4}-\d{2}-\d{2} \d{2}:\d{2}:\d{2}$)");
-    if (!std::regex_match(date, dateRegex)) {
+    static constexpr char PATTERN[] = "dddd-dd-dd dd:dd:dd";
+    if (date.size() != sizeof(PATTERN) - 1) {
         throw std::invalid_argument("Invalid date format. Use 'YYYY-MM-DD HH:MM:SS'.");
     }
+    for (size_t i = 0; i < date.size(); ++i) {
+        bool valid = PATTERN[i] == 'd' ? date[i] >= '0' && date[i] <= '9' : date[i] == PATTERN[i];
+        if (!valid) {
+            throw std::invalid_argument("Invalid date format. Use 'YYYY-MM-DD HH:MM:SS'.");
+        }
+    }
+
+    auto number = [&date](size_t position, size_t length) {
+        int value = 0;
+        for (size_t i = position; i < position + length; ++i) {
+            value = value * 10 + (date[i] - '0');
+        }
+        return value;
+    };
 
     std::tm timeInfo{};
-    try {
-        timeInfo.tm_year = std::stoi(date.substr(0, 4)) - 1900; // Год с 1900
-        timeInfo.tm_mon = std::stoi(date.substr(5, 2)) - 1;     // Месяцы от 0 до 11
-        timeInfo.tm_mday = std::stoi(date.substr(8, 2));
-        timeInfo.tm_hour = std::stoi(date.substr(11, 2));
-        timeInfo.tm_min = std::stoi(date.substr(14, 2));
-        timeInfo.tm_sec = std::stoi(date.substr(17, 2));
-    } catch (const std::exception &) {
-        throw std::invalid_argument("Invalid date values in input string.");
+    timeInfo.tm_year = number(0, 4) - 1900; // Год с 1900
+    timeInfo.tm_mon = number(5, 2) - 1;     // Месяцы от 0 до 11
+    timeInfo.tm_mday = number(8, 2);
+    timeInfo.tm_hour = number(11, 2);
+    timeInfo.tm_min = number(14, 2);
+    timeInfo.tm_sec = number(17, 2);
+
+    // месяц вне диапазона нормализует сам mktime
+    if (timeInfo.tm_mon < 0 || timeInfo.tm_mon > 11) {
+        time_t result = std::mktime(&timeInfo);
+        if (result == -1) {
+            throw std::invalid_argument("Failed to convert date to time_t.");
+        }
+        return result;
     }
 
-    time_t result = std::mktime(&timeInfo);
+    long long local = daysFromCivil(timeInfo.tm_year + 1900, timeInfo.tm_mon + 1, timeInfo.tm_mday) * 24 * 60 * 60
+                      + timeInfo.tm_hour * 60 * 60 + timeInfo.tm_min * 60 + timeInfo.tm_sec;
+    long long hour = (local >= 0 ? local : local - 3599) / 3600;
+
+    thread_local std::unordered_map<long long, long long> offsets;
+    auto it = offsets.find(hour);
+    if (it == offsets.end()) {
+        time_t exact = std::mktime(&timeInfo);
+        if (exact == -1) {
+            throw std::invalid_argument("Failed to convert date to time_t.");
+        }
+        it = offsets.emplace(hour, local - exact).first;
+    }
+
+    auto result = static_cast<time_t>(local - it->second);
     if (result == -1) {
         throw std::invalid_argument("Failed to convert date to time_t.");
     }
-
     return result;
 }
 
 
+// Буфер отчёта: текст собирается в одном переиспользуемом буфере через to_chars
+// и уходит в дескриптор или поток порциями по CHUNK байт. Без приёмника буфер
+// держит одну карточку товара и растёт только под неё
+class ReportBuffer {
+private:
+    static constexpr size_t CHUNK = 1 << 16;
+    static constexpr size_t LINE = 256;
+
+    std::string buffer;
+    int fd = -1;
+    std::ostream *stream = nullptr;
+
+    void flushIfFull() {
+        if (buffer.size() >= CHUNK) {
+            flush();
+        }
+    }
+
+public:
+    ReportBuffer() {
+        buffer.reserve(LINE);
+    }
+
+    explicit ReportBuffer(int fd) : fd(fd) {
+        buffer.reserve(CHUNK + 1024);
+    }
+
+    explicit ReportBuffer(std::ostream &stream) : stream(&stream) {
+        buffer.reserve(CHUNK + 1024);
+    }
+
+    ReportBuffer &operator<<(std::string_view text) {
+        buffer.append(text);
+        flushIfFull();
+        return *this;
+    }
+
+    // формат совпадает с выводом double в std::ostream по умолчанию (%g)
+    ReportBuffer &operator<<(double value) {
+        char digits[32];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::general, 6);
+        return *this << std::string_view(digits, static_cast<size_t>(result.ptr - digits));
+    }
+
+    ReportBuffer &operator<<(long long value) {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        return *this << std::string_view(digits, static_cast<size_t>(result.ptr - digits));
+    }
+
+    ReportBuffer &operator<<(unsigned int value) {
+        return *this << static_cast<long long>(value);
+    }
+
+    ReportBuffer &appendDate(time_t date) {
+        std::tm timeInfo{};
+        localtime_r(&date, &timeInfo);
+        char text[20];
+        size_t length = strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &timeInfo);
+        return *this << std::string_view(text, length);
+    }
+
+    std::string_view view() const { return buffer; }
+
+    void flush() {
+        if (stream != nullptr) {
+            stream->write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            buffer.clear();
+            return;
+        }
+        if (fd < 0) {
+            return;
+        }
+        size_t written = 0;
+        while (written < buffer.size()) {
+            ssize_t n = ::write(fd, buffer.data() + written, buffer.size() - written);
+            if (n < 0) {
+                throw std::runtime_error("Failed to write report.");
+            }
+            written += static_cast<size_t>(n);
+        }
+        buffer.clear();
+    }
+};
+
+
 class Product {
 private:
     std::string name;
@@ -82,17 +236,35 @@ public:
 
     virtual unsigned int getID() const { return id; }
 
-    virtual void displayInfo() const {
-        std::cout << "Name: " << name << "\nID: " << id
-                  << "\nWeight: " << weight << " kg\nPrice: $" << price
-                  << "\nStorage Period: " << storagePeriod << " days\n";
+    void displayInfo() const {
+        ReportBuffer out;
+        appendInfo(out, getCategory());
+        std::cout << out.view();
     }
 
+    // category передаётся снаружи, чтобы отчёт по складу не строил строку на каждый товар
+    virtual void appendInfo(ReportBuffer &out, std::string_view category) const {
+        (void) category;
+        out << "Name: " << name << "\nID: " << id
+            << "\nWeight: " << weight << " kg\nPrice: $" << price
+            << "\nStorage Period: " << storagePeriod << " days\n";
+    }
+
+    virtual std::unique_ptr<Product> clone() const { return std::make_unique<Product>(*this); }
+
     virtual double calculateStorageFee() const { return weight * 100; }
 
     virtual std::string getCategory() const { return "Product"; }
 
     virtual unsigned int getId() const { return id; }
+
+    const std::string &getName() const { return name; }
+
+    double getWeight() const { return weight; }
+
+    double getPrice() const { return price; }
+
+    unsigned int getStoragePeriod() const { return storagePeriod; }
 };
 
 class PerishableProduct : public Product {
@@ -100,12 +272,14 @@ private:
     time_t expirationDate;
 
 public:
+    explicit PerishableProduct(const std::string &name, unsigned int id, double weight, double price,
+                               unsigned int storagePeriod, time_t expirationDate)
+            : Product(name, id, weight, price, storagePeriod), expirationDate(expirationDate) {}
+
     explicit PerishableProduct(const std::string &name, unsigned int id, double weight, double price,
                                unsigned int storagePeriod,
                                const std::string &expirationDateStr)
-            : Product(name, id, weight, price, storagePeriod) {
-        this->expirationDate = parseDate(expirationDateStr);
-    }
+            : PerishableProduct(name, id, weight, price, storagePeriod, parseDate(expirationDateStr)) {}
 
     PerishableProduct(const PerishableProduct &other)
             : Product(other), expirationDate(other.expirationDate) {}
@@ -118,12 +292,10 @@ public:
         return *this;
     }
 
-    void displayInfo() const override {
-        Product::displayInfo();
-        std::tm *timeInfo = std::localtime(&expirationDate);
-        char buffer[20];
-        strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", timeInfo);
-        std::cout << "Expiration Date: " << buffer << "\nCategory: " << getCategory() << std::endl;
+    void appendInfo(ReportBuffer &out, std::string_view category) const override {
+        Product::appendInfo(out, category);
+        out << "Expiration Date: ";
+        out.appendDate(expirationDate) << "\nCategory: " << category << "\n";
     }
 
     double calculateStorageFee() const override {
@@ -141,11 +313,15 @@ public:
         }
     }
 
+    time_t getExpirationDate() const { return expirationDate; }
+
     bool isExpiringSoon(time_t thresholdDate) const {
         return expirationDate <= thresholdDate;
     }
 
     std::string getCategory() const override { return "PerishableProduct"; }
+
+    std::unique_ptr<Product> clone() const override { return std::make_unique<PerishableProduct>(*this); }
 };
 
 class ElectronicProduct : public Product {
@@ -155,21 +331,30 @@ private:
 
 public:
     explicit ElectronicProduct(const std::string &name, unsigned int id, double weight, double price, int storagePeriod,
-                               const std::string &warrantyPeriod, double powerRating)
+                               time_t warrantyPeriod, double powerRating)
             : Product(name, id, weight, price, storagePeriod) {
         if (powerRating < 0) {
             throw std::invalid_argument("Power rating must be non-negative.");
         }
-        this->warrantyPeriod = parseDate(warrantyPeriod);
+        this->warrantyPeriod = warrantyPeriod;
         this->powerRating = powerRating;
-
     }
 
+    explicit ElectronicProduct(const std::string &name, unsigned int id, double weight, double price, int storagePeriod,
+                               const std::string &warrantyPeriod, double powerRating)
+            : ElectronicProduct(name, id, weight, price, storagePeriod, parseDate(warrantyPeriod), powerRating) {}
+
     std::string getCategory() const override { return "ElectronicProduct"; }
 
+    std::unique_ptr<Product> clone() const override { return std::make_unique<ElectronicProduct>(*this); }
+
+    time_t getWarrantyPeriod() const { return warrantyPeriod; }
+
+    double getPowerRating() const { return powerRating; }
+
     ElectronicProduct(const ElectronicProduct &other)
             : Product(other), warrantyPeriod(other.warrantyPeriod) {
-        if (powerRating < 0) {
+        if (other.powerRating < 0) {
             throw std::invalid_argument("Power rating must be non-negative.");
         }
         this->powerRating = other.powerRating;
@@ -188,13 +373,10 @@ public:
         return *this;
     }
 
-    void displayInfo() const override {
-        Product::displayInfo();
-        std::tm *timeInfo = std::localtime(&warrantyPeriod);
-        char buffer[20];
-        strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", timeInfo);
-        std::cout << "Warranty Period: " << warrantyPeriod
-                  << "\nPower Rating: " << powerRating << " W\nCategory: " << getCategory() << std::endl;;
+    void appendInfo(ReportBuffer &out, std::string_view category) const override {
+        Product::appendInfo(out, category);
+        out << "Warranty Period: " << static_cast<long long>(warrantyPeriod)
+            << "\nPower Rating: " << powerRating << " W\nCategory: " << category << "\n";
     }
 };
 
@@ -227,71 +409,561 @@ public:
 
     std::string getCategory() const override { return "BuildingMaterial"; }
 
-    void displayInfo() const override {
-        Product::displayInfo();
-        std::cout << "Flammability: " << (flammability ? "Yes" : "No") << "\nCategory: " << getCategory() << std::endl;
+    std::unique_ptr<Product> clone() const override { return std::make_unique<BuildingMaterial>(*this); }
+
+    bool isFlammable() const { return flammability; }
+
+    void appendInfo(ReportBuffer &out, std::string_view category) const override {
+        Product::appendInfo(out, category);
+        out << "Flammability: " << (flammability ? "Yes" : "No") << "\nCategory: " << category << "\n";
     }
 };
 
+// Открытая адресация с линейным пробированием: ID товара -> позиция в векторе products.
+// Удаление сдвигает хвост кластера назад, поэтому надгробия не нужны.
+class ProductIndex {
+private:
+    static constexpr size_t MIN_CAPACITY = 16;
+
+    struct Slot {
+        unsigned int id;
+        size_t position;
+        bool used;
+    };
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+
+    size_t mask() const { return slots.size() - 1; }
+
+    static size_t hash(unsigned int id) {
+        std::uint64_t x = id * 0x9E3779B97F4A7C15ULL;
+        return static_cast<size_t>(x ^ (x >> 32));
+    }
+
+    size_t locate(unsigned int id) const {
+        size_t i = hash(id) & mask();
+        while (slots[i].used && slots[i].id != id) {
+            i = (i + 1) & mask();
+        }
+        return i;
+    }
+
+    // новый массив выделяется до того, как старый отдан: при bad_alloc индекс не меняется
+    void grow(size_t newCapacity) {
+        std::vector<Slot> old(newCapacity, Slot{0, 0, false});
+        slots.swap(old);
+        for (const auto &slot: old) {
+            if (slot.used) {
+                slots[locate(slot.id)] = slot;
+            }
+        }
+    }
+
+public:
+    static constexpr size_t npos = SIZE_MAX;
+
+    ProductIndex() : slots(MIN_CAPACITY, Slot{0, 0, false}) {}
+
+    size_t find(unsigned int id) const {
+        const Slot &slot = slots[locate(id)];
+        return slot.used ? slot.position : npos;
+    }
+
+    void reserve(size_t n) {
+        size_t capacity = slots.size();
+        while (n * 10 > capacity * 7) {
+            capacity *= 2;
+        }
+        if (capacity != slots.size()) {
+            grow(capacity);
+        }
+    }
+
+    // вставляет новый ID или обновляет позицию существующего
+    void assign(unsigned int id, size_t position) {
+        reserve(count + 1);
+        Slot &slot = slots[locate(id)];
+        if (!slot.used) {
+            slot = Slot{id, position, true};
+            count++;
+        } else {
+            slot.position = position;
+        }
+    }
+
+    void erase(unsigned int id) {
+        size_t hole = locate(id);
+        if (!slots[hole].used) {
+            return;
+        }
+
+        size_t i = hole;
+        while (true) {
+            i = (i + 1) & mask();
+            if (!slots[i].used) {
+                break;
+            }
+            size_t home = hash(slots[i].id) & mask();
+            // элемент можно перенести в дыру, только если дыра лежит на его пути пробирования
+            if (((i - home) & mask()) >= ((i - hole) & mask())) {
+                slots[hole] = slots[i];
+                hole = i;
+            }
+        }
+        slots[hole].used = false;
+        count--;
+    }
+
+    void clear() {
+        slots.assign(MIN_CAPACITY, Slot{0, 0, false});
+        count = 0;
+    }
+
+    size_t size() const { return count; }
+};
+
+enum class ProductKind : unsigned char {
+    Generic,
+    Perishable,
+    Electronic,
+    Building,
+    Other
+};
+
+ProductKind kindOf(const Product &product) {
+    const std::type_info &type = typeid(product);
+    if (type == typeid(PerishableProduct)) return ProductKind::Perishable;
+    if (type == typeid(ElectronicProduct)) return ProductKind::Electronic;
+    if (type == typeid(BuildingMaterial)) return ProductKind::Building;
+    if (type == typeid(Product)) return ProductKind::Generic;
+    return ProductKind::Other;
+}
+
+using ExpiryIndex = std::pmr::set<std::pair<time_t, Product *>>;
+
+// Накопленная плата за хранение. Плата скоропортящегося товара зависит только от зоны,
+// в которой он находится (>30, <=30, <=7, <=0 дней до срока), поэтому хранятся суммы
+// базовой платы по зонам на момент asOf. Моменты перехода между зонами упорядочены так же,
+// как индекс по сроку годности, и просматриваются только товары, пересёкшие порог.
+// asOf сдвигается и при изменении склада, и при чтении, поэтому каждый переход
+// обрабатывается один раз. Читатели под общей блокировкой склада сдвигают его под lock
+class FeeLedger {
+private:
+    static constexpr time_t DAY = 24 * 60 * 60;
+    static constexpr time_t THRESHOLDS[3] = {30 * DAY, 7 * DAY, 0};
+    static constexpr double FACTORS[4] = {1.0, 1.2, 1.5, 2.0};
+
+    std::mutex lock;
+    double fixedFee = 0;
+    double zoneBase[4] = {};
+    time_t asOf;
+
+    static int zone(time_t expirationDate, time_t at) {
+        int result = 0;
+        for (time_t threshold: THRESHOLDS) {
+            result += expirationDate <= at + threshold;
+        }
+        return result;
+    }
+
+    // подклассы PerishableProduct могут переопределять плату, их считают отдельно
+    static bool isTracked(const Product *product) {
+        return typeid(*product) == typeid(PerishableProduct);
+    }
+
+    void settleLocked(time_t now, const ExpiryIndex &expiry) {
+        if (now == asOf) {
+            return;
+        }
+        if (now < asOf) {
+            rebuild(now, expiry);
+            return;
+        }
+        for (int i = 0; i < 3; ++i) {
+            auto it = expiry.lower_bound({asOf + THRESHOLDS[i] + 1, nullptr});
+            for (; it != expiry.end() && it->first <= now + THRESHOLDS[i]; ++it) {
+                if (isTracked(it->second)) {
+                    double base = it->second->getWeight() * 100;
+                    zoneBase[i] -= base;
+                    zoneBase[i + 1] += base;
+                }
+            }
+        }
+        asOf = now;
+    }
+
+    void rebuild(time_t now, const ExpiryIndex &expiry) {
+        std::fill(std::begin(zoneBase), std::end(zoneBase), 0.0);
+        asOf = now;
+        for (const auto &[expirationDate, product]: expiry) {
+            if (isTracked(product)) {
+                zoneBase[zone(expirationDate, asOf)] += product->getWeight() * 100;
+            }
+        }
+    }
+
+public:
+    FeeLedger() : asOf(time(nullptr)) {}
+
+    // add*/remove* вызываются только при изменении склада, то есть под исключительной блокировкой
+    void addFixed(double fee) { fixedFee += fee; }
+
+    void removeFixed(double fee) { fixedFee -= fee; }
+
+    void addPerishable(const PerishableProduct &product) {
+        zoneBase[zone(product.getExpirationDate(), asOf)] += product.getWeight() * 100;
+    }
+
+    void removePerishable(const PerishableProduct &product) {
+        zoneBase[zone(product.getExpirationDate(), asOf)] -= product.getWeight() * 100;
+    }
+
+    void settle(time_t now, const ExpiryIndex &expiry) {
+        std::lock_guard guard(lock);
+        settleLocked(now, expiry);
+    }
+
+    // обнуляет накопленную погрешность, когда склад опустел
+    void reset() {
+        fixedFee = 0;
+        std::fill(std::begin(zoneBase), std::end(zoneBase), 0.0);
+    }
+
+    // сдвигает asOf к now и возвращает плату; безопасно из нескольких читателей сразу
+    double total(time_t now, const ExpiryIndex &expiry) {
+        std::lock_guard guard(lock);
+        settleLocked(now, expiry);
+        double result = fixedFee;
+        for (int i = 0; i < 4; ++i) {
+            result += zoneBase[i] * FACTORS[i];
+        }
+        return result;
+    }
+};
+
+#ifdef LAB5_ALLOC_STATS
+// Счётчик выделений из кучи для --alloc. Замена глобального operator new действует на всю
+// программу, поэтому собирается только с -DLAB5_ALLOC_STATS=ON
+std::atomic<size_t> allocationCount{0};
+
+void *operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+[[gnu::noinline]] void operator delete(void *memory, size_t) noexcept {
+    std::free(memory);
+}
+#endif
+
+// Удалитель для товаров, которые могут жить как в куче, так и в арене склада
+struct ProductDeleter {
+    std::pmr::memory_resource *resource = nullptr;
+    size_t size = 0;
+    size_t alignment = 0;
+
+    void operator()(Product *product) const {
+        if (!resource) {
+            delete product;
+            return;
+        }
+        product->~Product();
+        resource->deallocate(product, size, alignment);
+    }
+};
+
+using ProductPtr = std::unique_ptr<Product, ProductDeleter>;
+
+// Получатель изменений склада, например журнал для восстановления после перезапуска
+class WareHouseObserver {
+public:
+    virtual ~WareHouseObserver() = default;
+
+    virtual void productAdded(const Product &product) = 0;
+
+    virtual void productRemoved(unsigned int id) = 0;
+
+    virtual void cleared() = 0;
+};
+
 class WareHouse {
 private:
-    std::vector<std::unique_ptr<Product>> products;
+    static constexpr size_t NOT_OTHER = SIZE_MAX;
+
+    // положение товара во вторичных индексах; вектор идёт параллельно products.
+    // otherPosition — место в others или NOT_OTHER
+    struct ProductSlot {
+        unsigned int categoryId;
+        size_t bucketPosition;
+        size_t otherPosition;
+    };
+
+    // арена объявлена первой, чтобы пережить все товары и узлы индексов
+    std::pmr::unsynchronized_pool_resource arena;
+    std::vector<ProductPtr> products;
+    std::vector<ProductSlot> slots;
+    ProductIndex index;
+    // наследники Product, о которых склад не знает: их плата считается виртуальным вызовом
+    std::vector<const Product *> others;
+
+    std::unordered_map<std::string, unsigned int> categoryIds;
+    std::vector<std::string> categoryNames;
+    std::vector<std::vector<Product *>> categoryBuckets;
+    std::vector<unsigned int> categoryOrder;
+    // getCategory() у всех видов товаров возвращает константу, поэтому категорию
+    // достаточно узнать один раз на тип, а не строить строку при каждой вставке
+    std::vector<std::pair<const std::type_info *, unsigned int>> categoryByType;
+    ExpiryIndex expiryIndex{&arena};
+    // чтение платы сдвигает состояние журнала платы, поэтому он mutable и защищён своим mutex
+    mutable FeeLedger feeLedger;
+    WareHouseObserver *observer = nullptr;
+
+    unsigned int internCategory(const std::string &category) {
+        auto it = categoryIds.find(category);
+        if (it != categoryIds.end()) {
+            return it->second;
+        }
+        auto id = static_cast<unsigned int>(categoryNames.size());
+        categoryIds.emplace(category, id);
+        categoryNames.push_back(category);
+        categoryBuckets.emplace_back();
+        auto at = std::upper_bound(categoryOrder.begin(), categoryOrder.end(), category,
+                                   [this](const std::string &name, unsigned int other) {
+                                       return name < categoryNames[other];
+                                   });
+        categoryOrder.insert(at, id);
+        return id;
+    }
+
+    unsigned int categoryOf(const Product &product) {
+        const std::type_info *type = &typeid(product);
+        for (const auto &[known, categoryId]: categoryByType) {
+            if (*known == *type) {
+                return categoryId;
+            }
+        }
+        unsigned int categoryId = internCategory(product.getCategory());
+        categoryByType.emplace_back(type, categoryId);
+        return categoryId;
+    }
+
+    template<typename T>
+    static void reserveOneMore(std::vector<T> &column) {
+        if (column.size() == column.capacity()) {
+            column.reserve(std::max<size_t>(8, column.capacity() * 2));
+        }
+    }
+
+    void unlinkFromBucket(const ProductSlot &slot) {
+        auto &bucket = categoryBuckets[slot.categoryId];
+        if (slot.bucketPosition != bucket.size() - 1) {
+            Product *moved = bucket.back();
+            bucket[slot.bucketPosition] = moved;
+            slots[index.find(moved->getID())].bucketPosition = slot.bucketPosition;
+        }
+        bucket.pop_back();
+    }
 
 public:
     WareHouse() = default;
 
+    WareHouse(const WareHouse &) = delete;
+
+    WareHouse &operator=(const WareHouse &) = delete;
+
     WareHouse &operator+=(std::unique_ptr<Product> product) {
-        auto it = std::find_if(products.begin(), products.end(),
-                               [&product](const std::unique_ptr<Product> &p) {
-                                   return p->getID() == product->getID();
-                               });
-        if (it != products.end()) {
+        return insert(ProductPtr(product.release()));
+    }
+
+    // создаёт товар прямо в арене склада, без отдельного выделения из кучи
+    template<typename T, typename... Args>
+    T &emplace(Args &&... args) {
+        void *memory = arena.allocate(sizeof(T), alignof(T));
+        T *product;
+        try {
+            product = new(memory) T(std::forward<Args>(args)...);
+        } catch (...) {
+            arena.deallocate(memory, sizeof(T), alignof(T));
+            throw;
+        }
+        insert(ProductPtr(product, ProductDeleter{&arena, sizeof(T), alignof(T)}));
+        return *product;
+    }
+
+    // индексы сбрасываются целиком, память арены возвращается одним release().
+    // Это O(n): деструктор каждого товара вызывается, имя длиннее SSO лежит в куче,
+    // а товары из += и импорта CSV выделены не в арене
+    void clear() {
+        if (observer) {
+            observer->cleared();
+        }
+        expiryIndex.clear();
+        products.clear();
+        slots.clear();
+        index.clear();
+        others.clear();
+        for (auto &bucket: categoryBuckets) {
+            bucket.clear();
+        }
+        feeLedger.reset();
+        arena.release();
+    }
+
+    void setObserver(WareHouseObserver *newObserver) {
+        observer = newObserver;
+    }
+
+    void reserve(size_t n) {
+        products.reserve(n);
+        slots.reserve(n);
+        index.reserve(n);
+    }
+
+    WareHouse &insert(ProductPtr product) {
+        unsigned int id = product->getID();
+        if (index.find(id) != ProductIndex::npos) {
             throw std::runtime_error("Product with this ID already exists in the warehouse.");
         }
+
+        // Всё, что может бросить, идёт до первого изменения индексов: память под ещё один
+        // товар, узел индекса сроков и запись в журнал. Если журнал не принял товар,
+        // узел убирается, и склад остаётся прежним
+        unsigned int categoryId = categoryOf(*product);
+        auto &bucket = categoryBuckets[categoryId];
+        ProductKind kind = kindOf(*product);
+        reserveOneMore(bucket);
+        reserveOneMore(slots);
+        reserveOneMore(products);
+        if (kind == ProductKind::Other) {
+            reserveOneMore(others);
+        }
+        index.reserve(products.size() + 1);
+
+        feeLedger.settle(time(nullptr), expiryIndex);
+        auto *perishable = dynamic_cast<PerishableProduct *>(product.get());
+        ExpiryIndex::iterator expiryEntry;
+        if (perishable) {
+            expiryEntry = expiryIndex.emplace(perishable->getExpirationDate(), perishable).first;
+        }
+        if (observer) {
+            try {
+                observer->productAdded(*product);
+            } catch (...) {
+                if (perishable) {
+                    expiryIndex.erase(expiryEntry);
+                }
+                throw;
+            }
+        }
+
+        bucket.push_back(product.get());
+        size_t otherPosition = NOT_OTHER;
+        if (kind == ProductKind::Perishable) {
+            feeLedger.addPerishable(static_cast<const PerishableProduct &>(*product));
+        } else if (kind == ProductKind::Other) {
+            otherPosition = others.size();
+            others.push_back(product.get());
+        } else {
+            feeLedger.addFixed(product->calculateStorageFee());
+        }
+
+        index.assign(id, products.size());
+        slots.push_back({categoryId, bucket.size() - 1, otherPosition});
         products.push_back(std::move(product));
         return *this;
     }
 
+    // удаление через swap-and-pop: последний товар переезжает на место удалённого
     WareHouse &operator-=(unsigned int id) {
-        auto it = std::find_if(products.begin(), products.end(),
-                               [id](const std::unique_ptr<Product> &p) { return p->getID() == id; });
-        if (it == products.end()) {
+        size_t position = index.find(id);
+        if (position == ProductIndex::npos) {
             throw std::runtime_error("Product with this ID does not exist in the warehouse.");
         }
-        products.erase(it);
+        // журнал первым: если запись не удалась, товар остаётся на складе
+        if (observer) {
+            observer->productRemoved(id);
+        }
+
+        feeLedger.settle(time(nullptr), expiryIndex);
+        Product *removed = products[position].get();
+        if (auto *perishable = dynamic_cast<PerishableProduct *>(removed)) {
+            expiryIndex.erase({perishable->getExpirationDate(), perishable});
+        }
+        unlinkFromBucket(slots[position]);
+        size_t otherPosition = slots[position].otherPosition;
+        if (otherPosition != NOT_OTHER) {
+            if (otherPosition != others.size() - 1) {
+                others[otherPosition] = others.back();
+                slots[index.find(others[otherPosition]->getID())].otherPosition = otherPosition;
+            }
+            others.pop_back();
+        } else if (kindOf(*removed) == ProductKind::Perishable) {
+            feeLedger.removePerishable(static_cast<const PerishableProduct &>(*removed));
+        } else {
+            feeLedger.removeFixed(removed->calculateStorageFee());
+        }
+
+        // ID стирается до переназначения переехавшего, чтобы assign не расширял индекс
+        index.erase(id);
+        if (position != products.size() - 1) {
+            products[position] = std::move(products.back());
+            slots[position] = slots.back();
+            index.assign(products[position]->getID(), position);
+        }
+        products.pop_back();
+        slots.pop_back();
+        if (products.empty()) {
+            feeLedger.reset();
+        }
         return *this;
     }
 
     Product *operator[](unsigned int id) const {
-        auto it = std::find_if(products.begin(), products.end(),
-                               [id](const std::unique_ptr<Product> &p) { return p->getID() == id; });
-        if (it == products.end()) {
+        size_t position = index.find(id);
+        if (position == ProductIndex::npos) {
             return nullptr;
         }
-        return it->get();
+        return products[position].get();
     }
 
-    const std::vector<std::unique_ptr<Product>> &getProducts() const {
+    const std::vector<ProductPtr> &getProducts() const {
         return products;
     }
 
-    void displayAllProducts() {
-        std::sort(products.begin(), products.end(),
-                  [](const std::unique_ptr<Product> &left, const std::unique_ptr<Product> &right) {
-                      return left->getCategory() < right->getCategory();
-                  });
-        for (const auto &product: products) {
-            product->displayInfo();
-            std::cout << "--------------------\n";
+    // отчёт по всем товарам в порядке категорий, без сортировки и без выделений памяти
+    void writeReport(int fd) const {
+        ReportBuffer out(fd);
+        for (unsigned int categoryId: categoryOrder) {
+            for (const Product *product: categoryBuckets[categoryId]) {
+                product->appendInfo(out, categoryNames[categoryId]);
+                out << "--------------------\n";
+            }
         }
+        out.flush();
+    }
+
+    void displayAllProducts() const {
+        std::cout.flush();
+        std::fflush(stdout);
+        writeReport(STDOUT_FILENO);
     }
 
+    // Амортизированно O(1) плюс O(log n) на поиск порогов: каждый товар, пересёкший порог,
+    // учитывается один раз. Если часы ушли назад — пересчёт зон по индексу сроков годности
     double calculateTotalStorageFee() const {
-        double totalFee = 0;
-        for (const auto &product: products) {
-            totalFee += product->calculateStorageFee();
+        double total = feeLedger.total(time(nullptr), expiryIndex);
+        for (const Product *product: others) {
+            total += product->calculateStorageFee();
         }
-        return totalFee;
+        return total;
     }
 
     std::vector<Product *> getExpiringProducts(int days) const {
@@ -299,26 +971,623 @@ public:
         time_t now = time(nullptr);
         time_t thresholdDate = now + days * 24 * 60 * 60;
 
-        for (const auto &product: products) {
-            auto *perishable = dynamic_cast<PerishableProduct *>(product.get());
-            if (perishable && perishable->isExpiringSoon(thresholdDate)) {
-                expiringProducts.push_back(perishable);
+        for (const auto &[expirationDate, product]: expiryIndex) {
+            if (expirationDate > thresholdDate) {
+                break;
             }
+            expiringProducts.push_back(product);
         }
         return expiringProducts;
     }
 
     std::vector<Product *> getCategoryProducts(const std::string &category) const {
-        std::vector<Product *> answer;
-        for (const auto &product: products) {
-            if (product->getCategory() == category) {
-                answer.push_back(product.get());
+        auto it = categoryIds.find(category);
+        if (it == categoryIds.end()) {
+            return {};
+        }
+        return categoryBuckets[it->second];
+    }
+};
+
+// Файл, отображённый в память только для чтения
+class MappedFile {
+private:
+    int fd;
+    const char *bytes = nullptr;
+    size_t length = 0;
+
+    void map(const std::string &path) {
+        struct stat st{};
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw std::runtime_error("Cannot stat " + path);
+        }
+        length = static_cast<size_t>(st.st_size);
+        if (length > 0) {
+            void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("Cannot map " + path);
+            }
+            madvise(p, length, MADV_SEQUENTIAL);
+            bytes = static_cast<const char *>(p);
+        }
+    }
+
+public:
+    explicit MappedFile(const std::string &path) {
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+        map(path);
+    }
+
+    // отображает уже открытый файл; дескриптор копируется, владелец оставляет свой
+    MappedFile(int descriptor, const std::string &name) {
+        fd = dup(descriptor);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open " + name);
+        }
+        map(name);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile() {
+        if (bytes) {
+            munmap(const_cast<char *>(bytes), length);
+        }
+        close(fd);
+    }
+
+    const char *data() const { return bytes; }
+
+    size_t size() const { return length; }
+};
+
+// Строка CSV: категория,имя,id,вес,цена,срок хранения[,дата][,мощность|горючесть]
+// Категории совпадают с getCategory(), даты в формате parseDate.
+std::unique_ptr<Product> parseProductCsv(std::string_view line) {
+    std::string_view fields[8];
+    size_t count = 0;
+    while (count < 8) {
+        size_t comma = line.find(',');
+        fields[count++] = line.substr(0, comma);
+        if (comma == std::string_view::npos) {
+            line = {};
+            break;
+        }
+        line.remove_prefix(comma + 1);
+    }
+    if (!line.empty() || count < 6) {
+        throw std::invalid_argument("Invalid number of CSV fields.");
+    }
+
+    auto number = [](std::string_view field, auto &value) {
+        auto [end, error] = std::from_chars(field.data(), field.data() + field.size(), value);
+        if (error != std::errc() || end != field.data() + field.size()) {
+            throw std::invalid_argument("Invalid number in CSV field.");
+        }
+    };
+
+    std::string name(fields[1]);
+    unsigned int id, storagePeriod;
+    double weight, price;
+    number(fields[2], id);
+    number(fields[3], weight);
+    number(fields[4], price);
+    number(fields[5], storagePeriod);
+
+    std::string_view category = fields[0];
+    if (category == "PerishableProduct" && count == 7) {
+        return std::make_unique<PerishableProduct>(name, id, weight, price, storagePeriod,
+                                                   parseDate(std::string(fields[6])));
+    }
+    if (category == "ElectronicProduct" && count == 8) {
+        double powerRating;
+        number(fields[7], powerRating);
+        return std::make_unique<ElectronicProduct>(name, id, weight, price, static_cast<int>(storagePeriod),
+                                                   parseDate(std::string(fields[6])), powerRating);
+    }
+    if (category == "BuildingMaterial" && count == 7) {
+        unsigned int flammability;
+        number(fields[6], flammability);
+        return std::make_unique<BuildingMaterial>(name, id, weight, price, static_cast<int>(storagePeriod),
+                                                  flammability != 0);
+    }
+    if (category == "Product" && count == 6) {
+        return std::make_unique<Product>(name, id, weight, price, storagePeriod);
+    }
+    throw std::invalid_argument("Unknown product category in CSV.");
+}
+
+// Файл режется на куски по границам строк, куски разбираются параллельно,
+// товары добавляются на склад в исходном порядке.
+size_t importProductsCsv(WareHouse &warehouse, const std::string &path, unsigned int threads = 0) {
+    MappedFile file(path);
+    const char *begin = file.data();
+    const char *end = begin + file.size();
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = static_cast<unsigned int>(std::min<size_t>(threads, file.size() / (1 << 20) + 1));
+
+    std::vector<const char *> bounds{begin};
+    for (unsigned int i = 1; i < threads; ++i) {
+        const char *cut = std::max(bounds.back(), begin + file.size() * i / threads);
+        cut = std::find(cut, end, '\n');
+        bounds.push_back(cut == end ? end : cut + 1);
+    }
+    bounds.push_back(end);
+
+    std::vector<std::vector<std::unique_ptr<Product>>> parsed(threads);
+    std::vector<std::exception_ptr> errors(threads);
+    auto parseChunk = [&](unsigned int chunk) {
+        try {
+            const char *cursor = bounds[chunk];
+            const char *chunkEnd = bounds[chunk + 1];
+            while (cursor < chunkEnd) {
+                const char *lineEnd = std::find(cursor, chunkEnd, '\n');
+                std::string_view line(cursor, static_cast<size_t>(lineEnd - cursor));
+                if (!line.empty() && line.back() == '\r') {
+                    line.remove_suffix(1);
+                }
+                if (!line.empty()) {
+                    parsed[chunk].push_back(parseProductCsv(line));
+                }
+                cursor = lineEnd == chunkEnd ? chunkEnd : lineEnd + 1;
+            }
+        } catch (...) {
+            errors[chunk] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < threads; ++i) {
+        workers.emplace_back(parseChunk, i);
+    }
+    parseChunk(0);
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    for (const auto &error: errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    size_t total = 0;
+    for (const auto &chunk: parsed) {
+        total += chunk.size();
+    }
+    warehouse.reserve(warehouse.getProducts().size() + total);
+    for (auto &chunk: parsed) {
+        for (auto &product: chunk) {
+            warehouse += std::move(product);
+        }
+    }
+    return total;
+}
+
+// Упакованная запись товара: kind u8, id u32, weight f64, price f64, storagePeriod u32,
+// date i64, powerRating f64, flammability u8, длина имени u16, имя
+class ProductCodec {
+private:
+    template<typename T>
+    static void put(std::string &out, T value) {
+        out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    static T take(const char *&cursor, const char *end) {
+        if (static_cast<size_t>(end - cursor) < sizeof(T)) {
+            throw std::runtime_error("Truncated product record.");
+        }
+        T value;
+        std::memcpy(&value, cursor, sizeof(T));
+        cursor += sizeof(T);
+        return value;
+    }
+
+public:
+    static void encode(const Product &product, std::string &out) {
+        ProductKind kind = kindOf(product);
+        std::int64_t date = 0;
+        double powerRating = 0;
+        std::uint8_t flammability = 0;
+        switch (kind) {
+            case ProductKind::Perishable:
+                date = static_cast<const PerishableProduct &>(product).getExpirationDate();
+                break;
+            case ProductKind::Electronic:
+                date = static_cast<const ElectronicProduct &>(product).getWarrantyPeriod();
+                powerRating = static_cast<const ElectronicProduct &>(product).getPowerRating();
+                break;
+            case ProductKind::Building:
+                flammability = static_cast<const BuildingMaterial &>(product).isFlammable();
+                break;
+            case ProductKind::Generic:
+                break;
+            case ProductKind::Other:
+                throw std::runtime_error("Cannot serialize product of unknown type.");
+        }
+        if (product.getName().size() > UINT16_MAX) {
+            throw std::runtime_error("Product name is too long to serialize.");
+        }
+
+        put(out, static_cast<std::uint8_t>(kind));
+        put(out, static_cast<std::uint32_t>(product.getID()));
+        put(out, product.getWeight());
+        put(out, product.getPrice());
+        put(out, static_cast<std::uint32_t>(product.getStoragePeriod()));
+        put(out, date);
+        put(out, powerRating);
+        put(out, flammability);
+        put(out, static_cast<std::uint16_t>(product.getName().size()));
+        out += product.getName();
+    }
+
+    // разбирает одну запись и создаёт товар сразу в арене склада
+    static void decodeInto(WareHouse &warehouse, const char *&cursor, const char *end) {
+        auto kind = static_cast<ProductKind>(take<std::uint8_t>(cursor, end));
+        auto id = take<std::uint32_t>(cursor, end);
+        auto weight = take<double>(cursor, end);
+        auto price = take<double>(cursor, end);
+        auto storagePeriod = take<std::uint32_t>(cursor, end);
+        auto date = static_cast<time_t>(take<std::int64_t>(cursor, end));
+        auto powerRating = take<double>(cursor, end);
+        auto flammability = take<std::uint8_t>(cursor, end);
+        auto nameLength = take<std::uint16_t>(cursor, end);
+        if (static_cast<size_t>(end - cursor) < nameLength) {
+            throw std::runtime_error("Truncated product record.");
+        }
+        std::string name(cursor, nameLength);
+        cursor += nameLength;
+
+        switch (kind) {
+            case ProductKind::Perishable:
+                warehouse.emplace<PerishableProduct>(name, id, weight, price, storagePeriod, date);
+                return;
+            case ProductKind::Electronic:
+                warehouse.emplace<ElectronicProduct>(name, id, weight, price, static_cast<int>(storagePeriod),
+                                                     date, powerRating);
+                return;
+            case ProductKind::Building:
+                warehouse.emplace<BuildingMaterial>(name, id, weight, price, static_cast<int>(storagePeriod),
+                                                    flammability != 0);
+                return;
+            case ProductKind::Generic:
+                warehouse.emplace<Product>(name, id, weight, price, storagePeriod);
+                return;
+            case ProductKind::Other:
+                break;
+        }
+        throw std::runtime_error("Unknown product kind in record.");
+    }
+};
+
+static constexpr char PRODUCTS_MAGIC[4] = {'W', 'H', 'P', '1'};
+
+void exportProductsBinary(const WareHouse &warehouse, const std::string &path) {
+    const auto &products = warehouse.getProducts();
+    std::string buffer(PRODUCTS_MAGIC, sizeof(PRODUCTS_MAGIC));
+    auto count = static_cast<std::uint64_t>(products.size());
+    buffer.append(reinterpret_cast<const char *>(&count), sizeof(count));
+    for (const auto &product: products) {
+        ProductCodec::encode(*product, buffer);
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()))) {
+        throw std::runtime_error("Cannot write " + path);
+    }
+}
+
+size_t importProductsBinary(WareHouse &warehouse, const std::string &path) {
+    MappedFile file(path);
+    const char *cursor = file.data();
+    const char *end = cursor + file.size();
+    std::uint64_t count;
+    if (file.size() < sizeof(PRODUCTS_MAGIC) + sizeof(count)
+        || std::memcmp(cursor, PRODUCTS_MAGIC, sizeof(PRODUCTS_MAGIC)) != 0) {
+        throw std::runtime_error("Not a product file: " + path);
+    }
+    std::memcpy(&count, cursor + sizeof(PRODUCTS_MAGIC), sizeof(count));
+    cursor += sizeof(PRODUCTS_MAGIC) + sizeof(count);
+
+    warehouse.reserve(warehouse.getProducts().size() + count);
+    for (std::uint64_t i = 0; i < count; ++i) {
+        ProductCodec::decodeInto(warehouse, cursor, end);
+    }
+    return count;
+}
+
+std::uint64_t fnv1a(const char *data, size_t size) {
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Журнал изменений склада: заголовок (магия, поколение снимка), затем записи
+// [длина u32][операция u8][данные][fnv1a u64]. Операция '+' несёт запись товара,
+// '-' — ID, 'c' — очистку склада. Недописанный хвост после сбоя отрезается при открытии.
+class WareHouseJournal : public WareHouseObserver {
+private:
+    static constexpr char MAGIC[4] = {'W', 'H', 'L', '1'};
+    static constexpr size_t HEADER_SIZE = sizeof(MAGIC) + sizeof(std::uint64_t);
+
+    int fd;
+    std::uint64_t generation = 0;
+    size_t journalSize = 0;
+    std::string entry;
+
+    void writeAll(const std::string &bytes) {
+        size_t written = 0;
+        while (written < bytes.size()) {
+            ssize_t n = ::write(fd, bytes.data() + written, bytes.size() - written);
+            if (n < 0) {
+                throw std::runtime_error("Failed to write warehouse journal.");
             }
+            written += static_cast<size_t>(n);
+        }
+    }
+
+    void append(char operation, const std::string &payload) {
+        auto length = static_cast<std::uint32_t>(payload.size() + 1);
+        entry.assign(reinterpret_cast<const char *>(&length), sizeof(length));
+        entry += operation;
+        entry += payload;
+        std::uint64_t checksum = fnv1a(entry.data() + sizeof(length), length);
+        entry.append(reinterpret_cast<const char *>(&checksum), sizeof(checksum));
+        try {
+            writeAll(entry);
+        } catch (...) {
+            // недописанную запись отрезаем, иначе все следующие за ней не прочитаются при восстановлении
+            if (ftruncate(fd, static_cast<off_t>(journalSize)) != 0) {
+                throw std::runtime_error("Failed to write warehouse journal and to cut the torn entry.");
+            }
+            throw;
+        }
+        journalSize += entry.size();
+    }
+
+    // обходит целые записи журнала; возвращает смещение конца последней целой записи
+    template<typename Visit>
+    static size_t forEachEntry(const char *data, size_t size, Visit visit) {
+        size_t offset = HEADER_SIZE;
+        while (size - offset >= sizeof(std::uint32_t)) {
+            std::uint32_t length;
+            std::memcpy(&length, data + offset, sizeof(length));
+            size_t body = offset + sizeof(length);
+            if (length == 0 || size - body < length + sizeof(std::uint64_t)) {
+                break;
+            }
+            std::uint64_t checksum;
+            std::memcpy(&checksum, data + body + length, sizeof(checksum));
+            if (checksum != fnv1a(data + body, length)) {
+                break;
+            }
+            visit(data[body], data + body + 1, data + body + length);
+            offset = body + length + sizeof(checksum);
+        }
+        return offset;
+    }
+
+public:
+    explicit WareHouseJournal(const std::string &path) {
+        fd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+
+        try {
+            size_t valid = 0;
+            {
+                MappedFile file(fd, path);
+                if (file.size() >= HEADER_SIZE && std::memcmp(file.data(), MAGIC, sizeof(MAGIC)) == 0) {
+                    std::memcpy(&generation, file.data() + sizeof(MAGIC), sizeof(generation));
+                    valid = forEachEntry(file.data(), file.size(), [](char, const char *, const char *) {});
+                } else if (file.size() >= HEADER_SIZE || (file.size() > 0 && std::memcmp(
+                        file.data(), MAGIC, std::min(file.size(), sizeof(MAGIC))) != 0)) {
+                    // чужой файл не затираем: скорее всего, путь указан по ошибке
+                    throw std::runtime_error(path + " is not a warehouse journal");
+                }
+            }
+            if (valid == 0) {
+                reset(0);
+            } else if (ftruncate(fd, static_cast<off_t>(valid)) != 0) {
+                throw std::runtime_error("Cannot truncate " + path);
+            } else {
+                journalSize = valid;
+            }
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+    }
+
+    WareHouseJournal(const WareHouseJournal &) = delete;
+
+    WareHouseJournal &operator=(const WareHouseJournal &) = delete;
+
+    ~WareHouseJournal() {
+        close(fd);
+    }
+
+    std::uint64_t getGeneration() const { return generation; }
+
+    void productAdded(const Product &product) override {
+        std::string payload;
+        ProductCodec::encode(product, payload);
+        append('+', payload);
+    }
+
+    void productRemoved(unsigned int id) override {
+        auto value = static_cast<std::uint32_t>(id);
+        append('-', std::string(reinterpret_cast<const char *>(&value), sizeof(value)));
+    }
+
+    void cleared() override {
+        append('c', {});
+    }
+
+    // начинает журнал заново поверх снимка с указанным поколением
+    void reset(std::uint64_t newGeneration) {
+        if (ftruncate(fd, 0) != 0) {
+            throw std::runtime_error("Cannot truncate warehouse journal.");
+        }
+        generation = newGeneration;
+        std::string header(MAGIC, sizeof(MAGIC));
+        header.append(reinterpret_cast<const char *>(&generation), sizeof(generation));
+        writeAll(header);
+        journalSize = header.size();
+    }
+
+    void sync() const {
+        if (fsync(fd) != 0) {
+            throw std::runtime_error("Failed to sync warehouse journal.");
         }
-        return answer;
+    }
+
+    // применяет журнал к складу, восстановленному из снимка того же поколения
+    size_t replay(WareHouse &warehouse) const {
+        MappedFile file(fd, "warehouse journal");
+        size_t applied = 0;
+        forEachEntry(file.data(), file.size(), [&](char operation, const char *begin, const char *end) {
+            if (operation == '+') {
+                ProductCodec::decodeInto(warehouse, begin, end);
+            } else if (operation == 'c') {
+                warehouse.clear();
+            } else {
+                std::uint32_t id;
+                if (end - begin != sizeof(id)) {
+                    throw std::runtime_error("Corrupted journal entry.");
+                }
+                std::memcpy(&id, begin, sizeof(id));
+                warehouse -= id;
+            }
+            applied++;
+        });
+        return applied;
     }
 };
 
+// Снимок: магия, версия u32, поколение u64, число товаров u64, размер данных u64,
+// fnv1a данных u64, затем записи ProductCodec
+static constexpr char SNAPSHOT_MAGIC[4] = {'W', 'H', 'S', 'N'};
+static constexpr std::uint32_t SNAPSHOT_VERSION = 1;
+
+struct SnapshotHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint64_t generation;
+    std::uint64_t count;
+    std::uint64_t payloadSize;
+    std::uint64_t checksum;
+};
+
+// поколение снимка по пути path; 0, если снимка нет или он не читается
+std::uint64_t snapshotGeneration(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    SnapshotHeader header{};
+    bool valid = ::read(fd, &header, sizeof(header)) == static_cast<ssize_t>(sizeof(header))
+                 && std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0;
+    close(fd);
+    return valid ? header.generation : 0;
+}
+
+// пишет снимок во временный файл и атомарно подменяет им старый. Поколение всегда
+// больше, чем у прежнего снимка и у журнала, поэтому старый журнал к новому снимку
+// не применится; переданный журнал начинается заново с этим поколением
+void saveSnapshot(const WareHouse &warehouse, const std::string &path, WareHouseJournal *journal = nullptr) {
+    std::string buffer(sizeof(SnapshotHeader), '\0');
+    for (const auto &product: warehouse.getProducts()) {
+        ProductCodec::encode(*product, buffer);
+    }
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.generation = std::max(snapshotGeneration(path), journal ? journal->getGeneration() : 0) + 1;
+    header.count = warehouse.getProducts().size();
+    header.payloadSize = buffer.size() - sizeof(SnapshotHeader);
+    header.checksum = fnv1a(buffer.data() + sizeof(SnapshotHeader), header.payloadSize);
+    std::memcpy(buffer.data(), &header, sizeof(header));
+
+    std::string temporary = path + ".tmp";
+    int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + temporary);
+    }
+    size_t written = 0;
+    while (written < buffer.size()) {
+        ssize_t n = ::write(fd, buffer.data() + written, buffer.size() - written);
+        if (n < 0) {
+            close(fd);
+            std::remove(temporary.c_str());
+            throw std::runtime_error("Cannot write " + temporary);
+        }
+        written += static_cast<size_t>(n);
+    }
+    bool synced = fsync(fd) == 0;
+    bool closed = close(fd) == 0;
+    if (!synced || !closed || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("Cannot replace snapshot " + path);
+    }
+
+    if (journal) {
+        journal->reset(header.generation);
+    }
+}
+
+// загружает снимок и, если поколения совпадают, доигрывает хвост журнала, после чего
+// подключает журнал к складу; возвращает число восстановленных товаров
+size_t restoreWareHouse(WareHouse &warehouse, const std::string &snapshotPath, WareHouseJournal &journal) {
+    warehouse.setObserver(nullptr);
+    std::uint64_t generation = 0;
+    if (access(snapshotPath.c_str(), F_OK) == 0) {
+        MappedFile file(snapshotPath);
+        SnapshotHeader header{};
+        if (file.size() < sizeof(header)) {
+            throw std::runtime_error("Snapshot is truncated: " + snapshotPath);
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        const char *payload = file.data() + sizeof(header);
+        if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0
+            || header.version != SNAPSHOT_VERSION
+            || header.payloadSize != file.size() - sizeof(header)
+            || header.checksum != fnv1a(payload, header.payloadSize)) {
+            throw std::runtime_error("Snapshot is corrupted: " + snapshotPath);
+        }
+
+        warehouse.reserve(header.count);
+        const char *cursor = payload;
+        for (std::uint64_t i = 0; i < header.count; ++i) {
+            ProductCodec::decodeInto(warehouse, cursor, payload + header.payloadSize);
+        }
+        generation = header.generation;
+    }
+
+    if (journal.getGeneration() == generation) {
+        journal.replay(warehouse);
+    } else {
+        // журнал от другого снимка: его записи уже учтены либо не относятся к этому состоянию
+        journal.reset(generation);
+    }
+    warehouse.setObserver(&journal);
+    return warehouse.getProducts().size();
+}
+
 std::ostream &operator<<(std::ostream &os, const WareHouse &wareHouse) {
     const auto &products = wareHouse.getProducts();
 
@@ -327,16 +1596,308 @@ std::ostream &operator<<(std::ostream &os, const WareHouse &wareHouse) {
         return os;
     }
 
+    ReportBuffer out(os);
     for (const auto &product: products) {
         if (product != nullptr) {
-            os << product;
-            os << "----------------------------------------\n";
+            product->appendInfo(out, product->getCategory());
+            out << "----------------------------------------\n";
         }
     }
+    out.flush();
     return os;
 }
 
-int main() {
+// Потокобезопасный склад: товары разложены по шардам по ID, у каждого шарда свой
+// shared_mutex. Читатели получают копии товаров, поэтому параллельное удаление
+// не оставляет у них висячих указателей.
+class ConcurrentWareHouse {
+private:
+    struct alignas(64) Shard {
+        mutable std::shared_mutex lock;
+        WareHouse warehouse;
+    };
+
+    std::vector<Shard> shards;
+
+    Shard &shardFor(unsigned int id) { return shards[id % shards.size()]; }
+
+    const Shard &shardFor(unsigned int id) const { return shards[id % shards.size()]; }
+
+public:
+    explicit ConcurrentWareHouse(size_t shardCount = 64) : shards(std::max<size_t>(shardCount, 1)) {}
+
+    ConcurrentWareHouse &operator+=(std::unique_ptr<Product> product) {
+        Shard &shard = shardFor(product->getID());
+        std::unique_lock lock(shard.lock);
+        shard.warehouse += std::move(product);
+        return *this;
+    }
+
+    ConcurrentWareHouse &operator-=(unsigned int id) {
+        Shard &shard = shardFor(id);
+        std::unique_lock lock(shard.lock);
+        shard.warehouse -= id;
+        return *this;
+    }
+
+    std::unique_ptr<Product> operator[](unsigned int id) const {
+        const Shard &shard = shardFor(id);
+        std::shared_lock lock(shard.lock);
+        const Product *product = shard.warehouse[id];
+        return product ? product->clone() : nullptr;
+    }
+
+    std::vector<std::unique_ptr<Product>> getExpiringProducts(int days) const {
+        std::vector<std::unique_ptr<Product>> expiringProducts;
+        for (const Shard &shard: shards) {
+            std::shared_lock lock(shard.lock);
+            for (const Product *product: shard.warehouse.getExpiringProducts(days)) {
+                expiringProducts.push_back(product->clone());
+            }
+        }
+        std::sort(expiringProducts.begin(), expiringProducts.end(),
+                  [](const std::unique_ptr<Product> &left, const std::unique_ptr<Product> &right) {
+                      return static_cast<const PerishableProduct &>(*left).getExpirationDate()
+                             < static_cast<const PerishableProduct &>(*right).getExpirationDate();
+                  });
+        return expiringProducts;
+    }
+
+    double calculateTotalStorageFee() const {
+        double total = 0;
+        for (const Shard &shard: shards) {
+            std::shared_lock lock(shard.lock);
+            total += shard.warehouse.calculateTotalStorageFee();
+        }
+        return total;
+    }
+};
+
+// Сравнение с прежней реализацией: линейный find_if при каждой операции и erase со сдвигом
+void runBenchmark(unsigned int n) {
+    using Clock = std::chrono::steady_clock;
+    auto elapsed = [](Clock::time_point from) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - from).count();
+    };
+    auto make = [](unsigned int id) {
+        return std::make_unique<BuildingMaterial>("Brick", id, 1.0, 1.0, 10, false);
+    };
+
+    std::vector<std::unique_ptr<Product>> linear;
+    auto start = Clock::now();
+    for (unsigned int id = 0; id < n; ++id) {
+        auto it = std::find_if(linear.begin(), linear.end(),
+                               [id](const std::unique_ptr<Product> &p) { return p->getID() == id; });
+        if (it == linear.end()) {
+            linear.push_back(make(id));
+        }
+    }
+    double linearInsert = elapsed(start);
+
+    start = Clock::now();
+    size_t found = 0;
+    for (unsigned int id = 0; id < n; ++id) {
+        auto it = std::find_if(linear.begin(), linear.end(),
+                               [id](const std::unique_ptr<Product> &p) { return p->getID() == id; });
+        found += it != linear.end();
+    }
+    double linearLookup = elapsed(start);
+
+    start = Clock::now();
+    for (unsigned int id = 0; id < n; ++id) {
+        auto it = std::find_if(linear.begin(), linear.end(),
+                               [id](const std::unique_ptr<Product> &p) { return p->getID() == id; });
+        linear.erase(it);
+    }
+    double linearRemove = elapsed(start);
+
+    WareHouse warehouse;
+    start = Clock::now();
+    for (unsigned int id = 0; id < n; ++id) {
+        warehouse += make(id);
+    }
+    double indexedInsert = elapsed(start);
+
+    start = Clock::now();
+    for (unsigned int id = 0; id < n; ++id) {
+        found += warehouse[id] != nullptr;
+    }
+    double indexedLookup = elapsed(start);
+
+    start = Clock::now();
+    for (unsigned int id = 0; id < n; ++id) {
+        warehouse -= id;
+    }
+    double indexedRemove = elapsed(start);
+
+    std::cout << "N = " << n << " (found " << found << ")\n"
+              << "            linear, ms    indexed, ms\n"
+              << "insert  " << linearInsert << "  " << indexedInsert << "\n"
+              << "lookup  " << linearLookup << "  " << indexedLookup << "\n"
+              << "remove  " << linearRemove << "  " << indexedRemove << "\n";
+}
+
+// Писатели добавляют и удаляют товары в своих диапазонах ID, читатели ищут товары,
+// считают плату и список истекающих. Сравнивается один шард (глобальная блокировка) с 64.
+void runStressBenchmark(unsigned int threads, unsigned int operations) {
+    for (size_t shardCount: {size_t{1}, size_t{64}}) {
+        ConcurrentWareHouse warehouse(shardCount);
+        std::atomic<size_t> reads{0};
+        time_t now = time(nullptr);
+
+        auto writer = [&](unsigned int thread) {
+            unsigned int base = thread * operations;
+            for (unsigned int i = 0; i < operations; ++i) {
+                warehouse += std::make_unique<PerishableProduct>("Milk", base + i, 1.0, 1.0, 10,
+                                                                 now + static_cast<time_t>(i % 60) * 24 * 60 * 60);
+                if (i % 2 == 1) {
+                    warehouse -= base + i - 1;
+                }
+            }
+        };
+        auto reader = [&](unsigned int thread) {
+            size_t done = 0;
+            for (unsigned int i = 0; i < operations; ++i) {
+                done += warehouse[(thread * 7919 + i) % (operations * threads)] != nullptr;
+                if (i % 1024 == 0) {
+                    warehouse.calculateTotalStorageFee();
+                }
+                if (i % 16384 == 0) {
+                    warehouse.getExpiringProducts(1);
+                }
+            }
+            reads += done;
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (unsigned int i = 0; i < threads; ++i) {
+            workers.emplace_back(i % 2 == 0 ? std::function<void(unsigned int)>(writer) : reader, i / 2);
+        }
+        for (auto &worker: workers) {
+            worker.join();
+        }
+        std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - start;
+        std::cout << shardCount << " shard(s), " << threads << " threads: " << took.count() << " ms, "
+                  << static_cast<double>(threads) * operations / took.count() * 1000 << " ops/s, fee "
+                  << warehouse.calculateTotalStorageFee() << "\n";
+    }
+}
+
+// make_unique + += против emplace в арену: время вставки и очистки, а при сборке
+// с LAB5_ALLOC_STATS ещё и число выделений из кучи на одну вставку
+void runAllocationBenchmark(unsigned int n) {
+    time_t now = time(nullptr);
+    auto measure = [&](const char *label, auto insert) {
+        WareHouse warehouse;
+        warehouse.reserve(n);
+#ifdef LAB5_ALLOC_STATS
+        size_t before = allocationCount.load();
+#endif
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int id = 0; id < n; ++id) {
+            insert(warehouse, id);
+        }
+        std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - start;
+#ifdef LAB5_ALLOC_STATS
+        size_t inserts = allocationCount.load() - before;
+#endif
+
+        start = std::chrono::steady_clock::now();
+        warehouse.clear();
+        std::chrono::duration<double, std::milli> cleared = std::chrono::steady_clock::now() - start;
+        std::cout << label << ": ";
+#ifdef LAB5_ALLOC_STATS
+        std::cout << static_cast<double>(inserts) / n << " allocations per insert, ";
+#endif
+        std::cout << took.count() << " ms insert, " << cleared.count() << " ms clear\n";
+    };
+
+    measure("heap ", [now](WareHouse &warehouse, unsigned int id) {
+        if (id % 2 == 0) {
+            warehouse += std::make_unique<PerishableProduct>("Milk", id, 1.0, 1.0, 10, now);
+        } else {
+            warehouse += std::make_unique<BuildingMaterial>("Brick", id, 1.0, 1.0, 10, false);
+        }
+    });
+    measure("arena", [now](WareHouse &warehouse, unsigned int id) {
+        if (id % 2 == 0) {
+            warehouse.emplace<PerishableProduct>("Milk", id, 1.0, 1.0, 10u, now);
+        } else {
+            warehouse.emplace<BuildingMaterial>("Brick", id, 1.0, 1.0, 10, false);
+        }
+    });
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        runBenchmark(argc > 2 ? static_cast<unsigned int>(std::stoul(argv[2])) : 20000);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--alloc") {
+        runAllocationBenchmark(argc > 2 ? static_cast<unsigned int>(std::stoul(argv[2])) : 1000000);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--stress") {
+        runStressBenchmark(argc > 2 ? static_cast<unsigned int>(std::stoul(argv[2])) : 8,
+                           argc > 3 ? static_cast<unsigned int>(std::stoul(argv[3])) : 200000);
+        return 0;
+    }
+    if (argc > 3 && std::string(argv[1]) == "--restore") {
+        try {
+            // --restore <snapshot> <journal> [import-file]: поднять склад, дописать товары
+            // из файла через журнал и сохранить новый снимок
+            WareHouse warehouse;
+            WareHouseJournal journal(argv[3]);
+            auto start = std::chrono::steady_clock::now();
+            size_t count = restoreWareHouse(warehouse, argv[2], journal);
+            std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - start;
+            std::cout << "Restored " << count << " products in " << took.count() << " ms\n";
+            if (argc > 4) {
+                std::string path = argv[4];
+                path.ends_with(".bin") ? importProductsBinary(warehouse, path) : importProductsCsv(warehouse, path);
+                saveSnapshot(warehouse, argv[2], &journal);
+                std::cout << "Saved snapshot with " << warehouse.getProducts().size() << " products\n";
+            }
+        } catch (const std::exception &e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+        return 0;
+    }
+    if (argc > 2 && std::string(argv[1]) == "--report") {
+        try {
+            WareHouse warehouse;
+            std::string path = argv[2];
+            path.ends_with(".bin") ? importProductsBinary(warehouse, path) : importProductsCsv(warehouse, path);
+            warehouse.writeReport(STDOUT_FILENO);
+        } catch (const std::exception &e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+        return 0;
+    }
+    if (argc > 2 && std::string(argv[1]) == "--import") {
+        try {
+            // --import <file.csv|file.bin> [out.bin]
+            std::string path = argv[2];
+            WareHouse warehouse;
+            auto start = std::chrono::steady_clock::now();
+            size_t count = path.ends_with(".bin") ? importProductsBinary(warehouse, path)
+                                                  : importProductsCsv(warehouse, path);
+            std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - start;
+            std::cout << "Imported " << count << " products in " << took.count() << " ms\n"
+                      << "Total storage fee: $" << warehouse.calculateTotalStorageFee() << "\n";
+            if (argc > 3) {
+                exportProductsBinary(warehouse, argv[3]);
+            }
+        } catch (const std::exception &e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
     try {
         PerishableProduct P("", 2, -2, -5, 14, "2024-12-05 10:00:00");
         WareHouse warehouse;